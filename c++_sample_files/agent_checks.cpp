@@ -0,0 +1,136 @@
+// Native regression checks of the agent, run by ctest.
+//
+//   ./agent_checks
+//
+// Each check prints one line and the exit status is the number of failed
+// checks, so ctest reports any of them.
+#define STUDENT_AGENT_NO_PYBIND
+#include "student_agent.cpp"
+#include "referee.h"
+#include <cstdio>
+
+static int failures = 0;
+
+static void check(bool ok, const char* name, const string& detail = "") {
+    printf("%s %s%s%s\n", ok ? "ok  " : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+    if (!ok) failures++;
+}
+
+// a full tree handed to the next search keeps only a bounded part of it.
+// positions repeat, so the subtree under the new root can reach most of the
+// old tree; the worst case is searching the same position again
+static void check_reuse_shrinks_tree() {
+    vector<int> score_cols = score_cols_for(12);
+    BoardState start = start_position(13, 12);
+    StudentAgent agent(CIRCLE);
+    size_t cap = 2000;
+    agent.set_node_cap(cap);
+    agent.set_move_time(30.0);
+    agent.set_playout_limit(4000);
+    BoardState board = agent.prepare_board(start, score_cols);
+    agent.plan_search_time(board, score_cols, 0, 0);
+    agent.find_mcts_move(board, score_cols);
+    size_t before = (size_t)agent.get_tt_stats()["nodes"];
+
+    // the second search starts from the kept subtree
+    agent.set_playout_limit(1);
+    agent.find_mcts_move(board, score_cols);
+    size_t after = (size_t)agent.get_tt_stats()["reused_nodes"];
+    check(before >= cap / 2 && after > 0 && after <= cap / 8, "reuse_root shrinks the arena",
+          to_string(before) + " -> " + to_string(after) + " nodes");
+}
+
+// threads sharing one tree stop allocating at node_cap, however many of
+// them are expanding at once
+static void check_tree_parallel_node_cap() {
+    vector<int> score_cols = score_cols_for(12);
+    StudentAgent agent(CIRCLE);
+    size_t cap = 1000;
+    agent.set_parallel(8, "tree");
+    agent.set_node_cap(cap);
+    agent.set_move_time(30.0);
+    agent.set_playout_limit(3000);
+    BoardState board = agent.prepare_board(start_position(13, 12), score_cols);
+    agent.plan_search_time(board, score_cols, 0, 0);
+    size_t most = 0;
+    for (int run = 0; run < 4; ++run) {
+        agent.find_mcts_move(board, score_cols);
+        most = max(most, (size_t)agent.get_tt_stats()["nodes"]);
+    }
+    check(most <= cap, "tree-parallel search keeps to node_cap", to_string(most) + " nodes, cap " + to_string(cap));
+}
+
+// setters and stats getters refuse to run under a choose_async search
+static void check_calls_during_async_search() {
+    StudentAgent agent(CIRCLE);
+    agent.choose_async(MapBoard(13, vector<map<string, string>>(12)), 13, 12, score_cols_for(12), 60, 60);
+    bool refused = false;
+    try {
+        agent.set_node_cap(1000);
+    } catch (const runtime_error&) {
+        refused = true;
+    }
+    agent.result();
+    bool allowed = true;
+    try {
+        agent.set_node_cap(1000);
+        agent.get_tt_stats();
+    } catch (const runtime_error&) {
+        allowed = false;
+    }
+    check(refused && allowed, "setters wait for the choose_async result");
+}
+
+// pack_cells rejects bytes that are not a CELL_* code instead of writing
+// past the two players' bitboards
+static void check_bad_cell_codes() {
+    vector<int> score_cols = score_cols_for(12);
+    bool all_refused = true;
+    for (uint8_t code : {3, 7, 11, 4, 8, 16, 0x81}) {
+        vector<uint8_t> cells(13 * 12, 0);
+        cells[5 * 12 + 6] = code;
+        StudentAgent agent(CIRCLE);
+        try {
+            agent.choose_cells(cells.data(), 13, 12, score_cols, 60, 60);
+            all_refused = false;
+        } catch (const invalid_argument&) {
+        }
+    }
+    vector<uint8_t> cells(13 * 12, 0);
+    cells[0] = 1;
+    cells[1] = 2 | CELL_RIVER;
+    cells[2] = 1 | CELL_RIVER | CELL_VERTICAL;
+    BoardState board = pack_cells(cells.data(), 13, 12);
+    bool valid_kept = board.cell_at(0) == cells[0] && board.cell_at(1) == cells[1] && board.cell_at(2) == cells[2];
+    check(all_refused && valid_kept, "pack_cells validates cell codes");
+}
+
+// pack_board rejects map boards that do not fit the bitboards instead of
+// writing past them
+static void check_bad_map_boards() {
+    vector<int> score_cols = score_cols_for(12);
+    auto refused = [&](const MapBoard& board) {
+        StudentAgent agent(CIRCLE);
+        try {
+            agent.choose(board, board.size(), board.empty() ? 0 : board[0].size(), score_cols, 60, 60);
+        } catch (const invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    MapBoard too_large(17, vector<map<string, string>>(16));
+    MapBoard ragged(13, vector<map<string, string>>(12));
+    ragged[4].resize(13);
+    MapBoard bad_owner(13, vector<map<string, string>>(12));
+    bad_owner[5][6] = {{"owner", "triangle"}, {"side", "stone"}};
+    check(refused(too_large) && refused(ragged) && refused(bad_owner), "pack_board validates map boards");
+}
+
+int main() {
+    check_reuse_shrinks_tree();
+    check_tree_parallel_node_cap();
+    check_calls_during_async_search();
+    check_bad_cell_codes();
+    check_bad_map_boards();
+    return failures;
+}
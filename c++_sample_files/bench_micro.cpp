@@ -0,0 +1,163 @@
+// Per-call cost of the agent's hot functions on fixed positions, as JSON.
+//
+//   ./bench_micro [min_seconds] > micro.json
+//
+// Every function runs on an opening, a river-heavy midgame and a
+// near-terminal position until min_seconds (default 0.2) have passed. Each
+// entry holds ns per call and heap allocations per call; the simulate_playout
+// entries also give playouts per second. Keep the positions fixed so numbers
+// from two builds can be compared entry by entry.
+#define STUDENT_AGENT_NO_PYBIND
+#include "student_agent.cpp"
+#include "referee.h"
+#include <cstdio>
+#include <cstdlib>
+
+// every heap allocation of the process goes through here, the count taken
+// around a timed loop gives allocations per call
+static atomic<long long> heap_allocations{0};
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+// the other forms release through the one above, so every pointer from
+// operator new reaches free the same way
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+static const pair<const char*, const char*> POSITIONS[] = {
+    {"opening", "circle ............/............/............/...sSsSsSsSsSsS.../...sSsSsSsSsSsS.../............/............/............/...cScScScScScS.../...cScScScScScS.../............/............/............/"},
+    {"midgame", "square ............/............/............/...sHsSsSsSsS.sS../...sHsHsV.sH..../........sH.../............/....cVsS.cS..../..cHcH.cScS...../....cScScScScV.cV./............/............/............/"},
+    {"near_terminal", "circle ............/............/....cScScS...../....sSsH.cS..../......sScH..../.........cS../...cV......../........sS.../..cS....sH..cH./...sS..sV...../....sSsS....../............/............/"},
+};
+
+struct Measurement {
+    double ns_per_op;
+    double allocs_per_op;
+    long long ops;
+};
+
+// sink for results the compiler must not drop
+static volatile long long sink;
+
+// doubles the call count until one timed run lasts min_seconds
+template <typename F>
+static Measurement measure(double min_seconds, F&& call) {
+    call();
+    for (long long ops = 1;; ops *= 2) {
+        long long allocs = heap_allocations.load();
+        auto start = chrono::steady_clock::now();
+        for (long long i = 0; i < ops; ++i) call();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocs = heap_allocations.load() - allocs;
+        if (seconds >= min_seconds || ops >= (1LL << 30)) return {seconds * 1e9 / ops, (double)allocs / ops, ops};
+    }
+}
+
+int main(int argc, char** argv) {
+    double min_seconds = argc > 1 ? atof(argv[1]) : 0.2;
+
+    printf("{\n  \"min_seconds\": %g,\n  \"benchmarks\": [", min_seconds);
+    bool first = true;
+    auto report = [&](const char* name, const char* position, const Measurement& m, bool playouts) {
+        printf("%s\n    {\"name\": \"%s\", \"position\": \"%s\", \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, \"ops\": %lld",
+               first ? "" : ",", name, position, m.ns_per_op, m.allocs_per_op, m.ops);
+        if (playouts) printf(", \"playouts_per_sec\": %.0f", 1e9 / m.ns_per_op);
+        printf("}");
+        fflush(stdout);
+        first = false;
+    };
+
+    for (auto const& [label, line] : POSITIONS) {
+        BoardState position;
+        int player = 0;
+        if (!parse_position(line, position, player)) {
+            fprintf(stderr, "bad position %s\n", label);
+            return 1;
+        }
+        Player pid = Player(player);
+        vector<int> score_cols = score_cols_for(position.cols);
+        StudentAgent agent(pid);
+        BoardState board = agent.prepare_board(position, score_cols);
+        vector<PackedMove> moves = agent.get_all_moves(board, pid, score_cols);
+        if (moves.empty()) continue;
+        mt19937 rng(1);
+
+        report("get_all_moves", label, measure(min_seconds, [&] {
+            sink = agent.get_all_moves(board, pid, score_cols).size();
+        }), false);
+
+        // the river index playouts rebuild after every move that touches a river
+        RiverNetwork rivers;
+        report("refresh_rivers", label, measure(min_seconds, [&] {
+            rivers.valid = false;
+            agent.refresh_rivers(board, score_cols, rivers);
+            sink = rivers.landings[0].size();
+        }), false);
+
+        size_t next = 0;
+        report("try_move", label, measure(min_seconds, [&] {
+            sink = agent.try_move(board, moves[next++ % moves.size()], score_cols).hash;
+        }), false);
+
+        report("check_if_won", label, measure(min_seconds, [&] {
+            sink = agent.check_if_won(board, score_cols);
+        }), false);
+
+        report("find_playout_move", label, measure(min_seconds, [&] {
+            sink = agent.find_playout_move(moves, board, pid, score_cols, rng);
+        }), false);
+
+        // the batched step kernel over a full batch of this board, once per
+        // variant the cpu runs; the playouts call whichever step_targets holds
+        int lanes = 64;
+        vector<int> lane_players(lanes, pid);
+        vector<Bitboard> lane_pieces(lanes), lane_occupied(lanes), lane_steps(4 * lanes);
+        for (int m = 0; m < lanes; ++m) {
+            lane_pieces[m] = board.stones[pid];
+            lane_pieces[m] |= board.rivers[pid];
+            lane_occupied[m] = board.stones[0];
+            lane_occupied[m] |= board.stones[1];
+            lane_occupied[m] |= board.rivers[0];
+            lane_occupied[m] |= board.rivers[1];
+        }
+        vector<pair<const char*, StepKernel>> kernels = {{"step_targets_scalar", step_targets_scalar}};
+#ifdef STUDENT_AGENT_X86
+        if (__builtin_cpu_supports("avx2")) kernels.push_back({"step_targets_avx2", step_targets_avx2});
+#endif
+        for (auto const& [name, kernel] : kernels) {
+            report(name, label, measure(min_seconds, [&] {
+                kernel(*board.masks, lane_players.data(), lane_pieces.data(), lane_occupied.data(), lanes, lane_steps.data());
+                sink = lane_steps[0].w[0];
+            }), false);
+        }
+
+        // a small searched tree for the playout and selection entries
+        SearchTree tree;
+        tree.arena.reserve(1 << 14);
+        SearchWorker worker;
+        worker.rng.seed(1);
+        Node* root = agent.make_root(tree, board, pid, moves, score_cols, rng);
+        SearchClock clock;
+        clock.start = chrono::steady_clock::now();
+        clock.soft = clock.hard = 60.0;
+        clock.node_limit = 4000;
+        agent.run_search(tree, worker, root, score_cols, clock, false, 0);
+
+        report("simulate_playout", label, measure(min_seconds, [&] {
+            sink = agent.simulate_playout(worker, root, score_cols) * 2;
+        }), true);
+
+        vector<Node*> path;
+        report("mcts_select_init_node", label, measure(min_seconds, [&] {
+            sink = (long long)agent.mcts_select_init_node(tree, root, path, 0)->playouts;
+        }), false);
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Playouts per second of find_mcts_move for 1..N threads in both parallel modes.
+//
+//   ./bench_threads [max_threads] [searches_per_point] [playout_batch]
+//
+// max_threads defaults to the number of hardware threads, playout_batch to 1.
+#define STUDENT_AGENT_NO_PYBIND
+#include "student_agent.cpp"
+#include "referee.h"
+#include <cstdio>
+
+// a few seeded random plies so the search does not start from the opening
+static BoardState midgame_board(const vector<int>& score_cols) {
+    StudentAgent walker(CIRCLE);
+    BoardState board = start_position(13, 12);
+    mt19937 rng(7);
+    Player pid = CIRCLE;
+    for (int ply = 0; ply < 16; ++ply) {
+        auto moves = walker.get_all_moves(board, pid, score_cols);
+        if (moves.empty() || walker.check_if_won(board, score_cols) != NO_PLAYER) break;
+        board = walker.try_move(board, moves[rng() % moves.size()], score_cols);
+        pid = opponent_of(pid);
+    }
+    return board;
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)max(1u, thread::hardware_concurrency());
+    int searches = argc > 2 ? atoi(argv[2]) : 10;
+    int batch = argc > 3 ? atoi(argv[3]) : 1;
+    vector<int> score_cols = score_cols_for(12);
+    BoardState board = midgame_board(score_cols);
+
+    vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) counts.push_back(threads);
+    counts.push_back(max_threads);
+
+    for (string mode : {"root", "tree"}) {
+        double base = 0.0;
+        cout << mode << " parallel" << endl;
+        cout << "threads  playouts/s  speedup" << endl;
+        for (int threads : counts) {
+            long long playouts = 0;
+            double seconds = 0.0;
+            for (int k = 0; k < searches; ++k) {
+                // a fresh agent each time so no search starts from a reused tree
+                StudentAgent agent(CIRCLE);
+                agent.set_parallel(threads, mode);
+                agent.set_playout_batch(batch);
+                auto start = chrono::steady_clock::now();
+                agent.find_mcts_move(board, score_cols);
+                seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                playouts += (long long)agent.get_tt_stats()["playouts"];
+            }
+            double rate = playouts / seconds;
+            if (threads == 1) base = rate;
+            printf("%7d  %10.0f  %7.2f\n", threads, rate, rate / base);
+        }
+        cout << endl;
+    }
+    return 0;
+}
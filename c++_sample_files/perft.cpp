@@ -0,0 +1,113 @@
+// Move-generation perft: leaf counts to depth N from the positions in a file.
+//
+//   ./perft <positions> <depth> [--expect perft_expected.txt] [--agent [--check]]
+//
+// By default it walks the referee's move tree (referee.h) and, with
+// --expect, compares every count with the dump perft.py writes from
+// gameEngine.py. With --agent it walks the agent's own pruned tree
+// (get_all_moves / try_move) instead, and --expect takes the agent's counts
+// (perft_agent_expected.txt); --check adds a test that every move the agent
+// generates is one the referee accepts. Exits non-zero on any mismatch or
+// illegal move, so it can gate move-generator changes.
+#define STUDENT_AGENT_NO_PYBIND
+#include "student_agent.cpp"
+#include "referee.h"
+#include <cstdio>
+#include <cstring>
+
+struct PerftRun {
+    long long leaves = 0;
+    long long nodes = 0;
+    long long illegal = 0;
+};
+
+static long long referee_perft(const Referee& referee, const BoardState& board, int player, int depth, PerftRun& run) {
+    run.nodes++;
+    if (depth == 0 || referee.winner(board) >= 0) return 1;
+    long long total = 0;
+    for (PackedMove move : referee.legal_moves(board, player)) {
+        BoardState child = board;
+        referee.apply(child, move);
+        total += referee_perft(referee, child, 1 - player, depth - 1, run);
+    }
+    return total;
+}
+
+static long long agent_perft(StudentAgent& agent, const Referee* referee, const BoardState& board, int player, int depth, const vector<int>& score_cols, PerftRun& run) {
+    run.nodes++;
+    if (depth == 0 || agent.check_if_won(board, score_cols) != NO_PLAYER) return 1;
+    Player pid = Player(player);
+    long long total = 0;
+    for (PackedMove move : agent.get_all_moves(board, pid, score_cols)) {
+        if (referee && !referee->is_legal(board, player, move)) {
+            if (run.illegal++ < 10) {
+                Move m = unpack_move(move, board.cols);
+                fprintf(stderr, "illegal %s move %s from (%d,%d)\n", player_name(pid), m.action.c_str(), m.from[0], m.from[1]);
+            }
+            continue;
+        }
+        total += agent_perft(agent, referee, agent.try_move(board, move, score_cols), 1 - player, depth - 1, score_cols, run);
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <positions> <depth> [--expect file] [--agent [--check]]\n", argv[0]);
+        return 2;
+    }
+    int max_depth = atoi(argv[2]);
+    string expect_path;
+    bool agent_mode = false, check = false;
+    for (int i = 3; i < argc; ++i) {
+        if (!strcmp(argv[i], "--expect") && i + 1 < argc) expect_path = argv[++i];
+        else if (!strcmp(argv[i], "--agent")) agent_mode = true;
+        else if (!strcmp(argv[i], "--check")) check = true;
+        else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    auto positions = load_positions(argv[1]);
+    map<pair<int, int>, long long> expected;
+    if (!expect_path.empty()) {
+        ifstream in(expect_path);
+        int index, depth;
+        long long count;
+        while (in >> index >> depth >> count) expected[{index, depth}] = count;
+    }
+
+    int mismatches = 0;
+    long long illegal = 0;
+    printf("pos depth %14s %12s %12s%s\n", "leaves", "nodes", "nodes/s", expected.empty() ? "" : "  expected");
+    for (size_t index = 0; index < positions.size(); ++index) {
+        const auto& [board, player] = positions[index];
+        vector<int> score_cols = score_cols_for(board.cols);
+        Referee referee(board.rows, board.cols, score_cols);
+        StudentAgent agent(static_cast<Player>(player));
+        for (int depth = 1; depth <= max_depth; ++depth) {
+            PerftRun run;
+            auto start = chrono::steady_clock::now();
+            if (agent_mode) {
+                BoardState prepared = agent.prepare_board(board, score_cols);
+                run.leaves = agent_perft(agent, check ? &referee : nullptr, prepared, player, depth, score_cols, run);
+            } else {
+                run.leaves = referee_perft(referee, board, player, depth, run);
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            illegal += run.illegal;
+            printf("%3zu %5d %14lld %12lld %12.0f", index, depth, run.leaves, run.nodes, run.nodes / max(seconds, 1e-9));
+            auto it = expected.find({(int)index, depth});
+            if (it != expected.end()) {
+                bool ok = it->second == run.leaves;
+                mismatches += !ok;
+                printf("  %lld%s", it->second, ok ? "" : "  MISMATCH");
+            }
+            printf("\n");
+        }
+    }
+    if (check) printf("illegal agent moves: %lld\n", illegal);
+    if (mismatches) printf("%d count(s) differ from %s\n", mismatches, expect_path.c_str());
+    return (mismatches || illegal) ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+"""
+Leaf counts of the referee's move tree, the reference perft.cpp checks
+its own rules against.
+
+    python3 perft.py perft_positions.txt 2 > perft_expected.txt
+
+Legal moves are the ones the GUI offers (compute_valid_targets plus every
+flip and rotation), applied with validate_and_apply_move. A won position
+counts as a leaf. Output lines are "<position> <depth> <count>", positions
+numbered from 0 in file order.
+"""
+
+import contextlib
+import io
+import sys
+import types
+
+# only the rules are needed, keep gameEngine from loading the agents
+sys.modules.setdefault("agent", types.SimpleNamespace(get_agent=None))
+import gameEngine as ge
+
+
+def parse_position(line):
+    side, cells = line.split()
+    board = []
+    for row_text in cells.strip("/").split("/"):
+        row = []
+        i = 0
+        while i < len(row_text):
+            if row_text[i] == ".":
+                row.append(None)
+                i += 1
+                continue
+            owner = "circle" if row_text[i] == "c" else "square"
+            kind = row_text[i + 1]
+            if kind == "S":
+                row.append(ge.Piece(owner, "stone"))
+            else:
+                row.append(ge.Piece(owner, "river", "vertical" if kind == "V" else "horizontal"))
+            i += 2
+        board.append(row)
+    return board, side
+
+
+def copy_board(board):
+    return [[p.copy() if p else None for p in row] for row in board]
+
+
+def legal_moves(board, player, rows, cols, score_cols):
+    moves = []
+    for y in range(rows):
+        for x in range(cols):
+            p = board[y][x]
+            if not p or p.owner != player:
+                continue
+            info = ge.compute_valid_targets(board, x, y, player, rows, cols, score_cols)
+            for tx, ty in info["moves"]:
+                moves.append({"action": "move", "from": [x, y], "to": [tx, ty]})
+            for (tx, ty), (px, py) in info["pushes"]:
+                moves.append({"action": "push", "from": [x, y], "to": [tx, ty], "pushed_to": [px, py]})
+            if p.side == "stone":
+                for ori in ("horizontal", "vertical"):
+                    moves.append({"action": "flip", "from": [x, y], "orientation": ori})
+            else:
+                moves.append({"action": "flip", "from": [x, y]})
+                moves.append({"action": "rotate", "from": [x, y]})
+    return moves
+
+
+def perft(board, player, depth, rows, cols, score_cols):
+    if depth == 0 or ge.check_win(board, rows, cols, score_cols):
+        return 1
+    total = 0
+    for move in legal_moves(board, player, rows, cols, score_cols):
+        child = copy_board(board)
+        # validate_and_apply_move prints "invalid" for every rejected move
+        with contextlib.redirect_stdout(io.StringIO()):
+            ok, _ = ge.validate_and_apply_move(child, move, player, rows, cols, score_cols)
+        if ok:
+            total += perft(child, ge.opponent(player), depth - 1, rows, cols, score_cols)
+    return total
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: perft.py <positions> <depth>")
+    max_depth = int(sys.argv[2])
+    with open(sys.argv[1]) as fh:
+        lines = [l.strip() for l in fh if l.strip() and not l.startswith("#")]
+    for index, line in enumerate(lines):
+        board, side = parse_position(line)
+        rows, cols = len(board), len(board[0])
+        score_cols = ge.score_cols_for(cols)
+        for depth in range(1, max_depth + 1):
+            print(index, depth, perft(board, side, depth, rows, cols, score_cols), flush=True)
+
+
+if __name__ == "__main__":
+    main()
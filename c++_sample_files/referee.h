@@ -0,0 +1,281 @@
+// the game rules of gameEngine.py on a BoardState, for native tools that
+// check or play the agent without python in the loop. include it after
+// student_agent.cpp.
+//
+// legal moves are the ones the gui offers: compute_valid_targets for moves
+// and pushes, plus every flip and rotation. moves are applied the way
+// validate_and_apply_move applies them
+#pragma once
+
+#include <fstream>
+#include <sstream>
+
+struct Referee {
+    int rows;
+    int cols;
+    vector<int> score_cols;
+
+    Referee(int rows, int cols, const vector<int>& score_cols) : rows(rows), cols(cols), score_cols(score_cols) {}
+
+    bool in_bounds(int x, int y) const { return x >= 0 && x < cols && y >= 0 && y < rows; }
+
+    // player 0 is circle, which scores on the top row (2) and may not enter
+    // the bottom one (rows - 3)
+    bool is_opponent_score_cell(int x, int y, int player) const {
+        int row = (player == 0) ? rows - 3 : 2;
+        return y == row && find(score_cols.begin(), score_cols.end(), x) != score_cols.end();
+    }
+
+    bool is_own_score_cell(int x, int y, int player) const { return is_opponent_score_cell(x, y, 1 - player); }
+
+    // get_river_flow_destinations: cells a piece of player reaches by
+    // entering the river at (rx, ry) from (sx, sy). with river_push the cell
+    // at (rx, ry) is read as the pushing river at (sx, sy)
+    Bitboard flow_destinations(const BoardState& board, int rx, int ry, int sx, int sy, int player, bool river_push) const {
+        Bitboard destinations, visited;
+        int queue[MAX_CELLS * 4];
+        int head = 0, tail = 0;
+        queue[tail++] = board.index(rx, ry);
+        while (head < tail) {
+            int cur = queue[head++];
+            int x = cur % cols, y = cur / cols;
+            if (visited.test(cur)) continue;
+            visited.set(cur);
+            uint8_t cell = board.cell_at(cur);
+            if (river_push && x == rx && y == ry) cell = board.cell(sx, sy);
+            if (cell == CELL_EMPTY) {
+                if (!is_opponent_score_cell(x, y, player)) destinations.set(cur);
+                continue;
+            }
+            if (!(cell & CELL_RIVER)) continue;
+            bool vertical = cell & CELL_VERTICAL;
+            int dx = vertical ? 0 : 1, dy = vertical ? 1 : 0;
+            for (int dir = 1; dir >= -1; dir -= 2) {
+                int nx = x + dx * dir, ny = y + dy * dir;
+                while (in_bounds(nx, ny)) {
+                    if (is_opponent_score_cell(nx, ny, player)) break;
+                    if (board.is_empty(nx, ny)) {
+                        destinations.set(board.index(nx, ny));
+                        nx += dx * dir;
+                        ny += dy * dir;
+                        continue;
+                    }
+                    if (nx == sx && ny == sy) {
+                        nx += dx * dir;
+                        ny += dy * dir;
+                        continue;
+                    }
+                    if (board.is_river(nx, ny)) queue[tail++] = board.index(nx, ny);
+                    break;
+                }
+            }
+        }
+        return destinations;
+    }
+
+    // compute_valid_targets: step and flow destinations as a cell set, and
+    // pushes as (to, pushed_to) pairs. stone pushes validate_and_apply_move
+    // rejects (into the pushed piece's forbidden scoring cells) are left out
+    void valid_targets(const BoardState& board, int sx, int sy, Bitboard& moves, vector<pair<int, int>>& pushes) const {
+        static const pair<int, int> dirs[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        moves = Bitboard();
+        pushes.clear();
+        int player = board.owner(sx, sy);
+        if (player < 0) return;
+        for (auto const& [dx, dy] : dirs) {
+            int tx = sx + dx, ty = sy + dy;
+            if (!in_bounds(tx, ty) || is_opponent_score_cell(tx, ty, player)) continue;
+            if (board.is_empty(tx, ty)) {
+                moves.set(board.index(tx, ty));
+            } else if (board.is_river(tx, ty)) {
+                moves |= flow_destinations(board, tx, ty, sx, sy, player, false);
+            } else if (board.is_stone(sx, sy)) {
+                int px = tx + dx, py = ty + dy;
+                if (in_bounds(px, py) && board.is_empty(px, py) && !is_opponent_score_cell(px, py, player) &&
+                    !is_opponent_score_cell(px, py, board.owner(tx, ty))) {
+                    pushes.push_back({board.index(tx, ty), board.index(px, py)});
+                }
+            } else {
+                int pushed_player = board.owner(tx, ty);
+                flow_destinations(board, tx, ty, sx, sy, pushed_player, true).for_each([&](int d) {
+                    if (!is_opponent_score_cell(d % cols, d / cols, pushed_player)) pushes.push_back({board.index(tx, ty), d});
+                });
+            }
+        }
+    }
+
+    vector<PackedMove> legal_moves(const BoardState& board, int player) const {
+        vector<PackedMove> moves;
+        Bitboard targets;
+        vector<pair<int, int>> pushes;
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < cols; ++x) {
+                if (board.owner(x, y) != player) continue;
+                int from = board.index(x, y);
+                valid_targets(board, x, y, targets, pushes);
+                targets.for_each([&](int to) { moves.push_back(pack_move(MOVE_STEP, from, to)); });
+                for (auto const& [to, pushed_to] : pushes) moves.push_back(pack_move(MOVE_PUSH, from, to, pushed_to));
+                // flip and rotate never let a flow into the opponent's
+                // scoring area, flow destinations stop in front of it
+                if (board.is_stone(x, y)) {
+                    moves.push_back(pack_move(MOVE_FLIP, from, from, 0, ORIENT_HORIZONTAL));
+                    moves.push_back(pack_move(MOVE_FLIP, from, from, 0, ORIENT_VERTICAL));
+                } else {
+                    moves.push_back(pack_move(MOVE_FLIP, from, from));
+                    moves.push_back(pack_move(MOVE_ROTATE, from, from));
+                }
+            }
+        }
+        return moves;
+    }
+
+    bool is_legal(const BoardState& board, int player, PackedMove move) const {
+        int from = move_from(move);
+        int x = from % cols, y = from / cols;
+        if (!in_bounds(x, y) || board.owner(x, y) != player) return false;
+        switch (move_kind(move)) {
+        case MOVE_STEP:
+        case MOVE_PUSH: {
+            Bitboard targets;
+            vector<pair<int, int>> pushes;
+            valid_targets(board, x, y, targets, pushes);
+            if (move_kind(move) == MOVE_STEP) return targets.test(move_to(move));
+            return find(pushes.begin(), pushes.end(), make_pair(move_to(move), move_pushed_to(move))) != pushes.end();
+        }
+        case MOVE_FLIP:
+            return board.is_stone(x, y) ? move_orientation(move) != ORIENT_NONE : true;
+        default:
+            return board.is_river(x, y);
+        }
+    }
+
+    // validate_and_apply_move for a legal move: steps keep the piece as it
+    // is, a pusher that is a river lands stone side up
+    void apply(BoardState& board, PackedMove move) const {
+        int from = move_from(move), to = move_to(move);
+        uint8_t piece = board.cell_at(from);
+        switch (move_kind(move)) {
+        case MOVE_STEP:
+            board.set_cell_at(to, piece);
+            board.set_cell_at(from, CELL_EMPTY);
+            break;
+        case MOVE_PUSH:
+            board.set_cell_at(move_pushed_to(move), board.cell_at(to));
+            board.set_cell_at(to, piece & CELL_OWNER_MASK);
+            board.set_cell_at(from, CELL_EMPTY);
+            break;
+        case MOVE_FLIP:
+            if (piece & CELL_RIVER) board.set_cell_at(from, piece & CELL_OWNER_MASK);
+            else board.set_cell_at(from, piece | CELL_RIVER | (move_orientation(move) == ORIENT_VERTICAL ? CELL_VERTICAL : 0));
+            break;
+        default:
+            board.set_cell_at(from, piece ^ CELL_VERTICAL);
+            break;
+        }
+    }
+
+    // a move as the agent returns it to python, packed. NO_MOVE for an
+    // unknown action or a cell off the board; legality is is_legal's job
+    PackedMove pack(const Move& move) const {
+        auto cell = [&](const vector<int>& xy, int& index) {
+            if (xy.size() != 2 || !in_bounds(xy[0], xy[1])) return false;
+            index = xy[1] * cols + xy[0];
+            return true;
+        };
+        int from, to, pushed_to;
+        if (!cell(move.from, from)) return NO_MOVE;
+        if (move.action == "move") return cell(move.to, to) ? pack_move(MOVE_STEP, from, to) : NO_MOVE;
+        if (move.action == "push") return cell(move.to, to) && cell(move.pushed_to, pushed_to) ? pack_move(MOVE_PUSH, from, to, pushed_to) : NO_MOVE;
+        if (move.action == "rotate") return pack_move(MOVE_ROTATE, from, from);
+        if (move.action != "flip") return NO_MOVE;
+        uint32_t orientation = ORIENT_NONE;
+        if (move.orientation == "horizontal") orientation = ORIENT_HORIZONTAL;
+        else if (move.orientation == "vertical") orientation = ORIENT_VERTICAL;
+        return pack_move(MOVE_FLIP, from, from, 0, orientation);
+    }
+
+    // check_win: 0 circle, 1 square, -1 nobody. circle is checked first
+    int winner(const BoardState& board) const {
+        int count[2] = {0, 0};
+        for (int x : score_cols) {
+            if (in_bounds(x, 2) && board.owner(x, 2) == 0 && board.is_stone(x, 2)) count[0]++;
+            if (in_bounds(x, rows - 3) && board.owner(x, rows - 3) == 1 && board.is_stone(x, rows - 3)) count[1]++;
+        }
+        if (count[0] >= 4) return 0;
+        if (count[1] >= 4) return 1;
+        return -1;
+    }
+};
+
+// positions for the native tools, one per line: the side to move, then the
+// rows separated by '/', a cell being '.' or the owner ('c' or 's') followed
+// by 'S' for a stone, 'H' or 'V' for a river
+inline bool parse_position(const string& line, BoardState& board, int& player) {
+    istringstream in(line);
+    string side, cells;
+    if (!(in >> side >> cells) || (side != "circle" && side != "square")) return false;
+    player = player_of(side);
+    vector<vector<uint8_t>> grid(1);
+    for (size_t i = 0; i < cells.size(); ++i) {
+        char c = cells[i];
+        if (c == '/') {
+            if (!grid.back().empty()) grid.emplace_back();
+            continue;
+        }
+        if (c == '.') {
+            grid.back().push_back(CELL_EMPTY);
+            continue;
+        }
+        if ((c != 'c' && c != 's') || i + 1 >= cells.size()) return false;
+        char kind = cells[++i];
+        uint8_t code = (c == 'c') ? 1 : 2;
+        if (kind == 'H') code |= CELL_RIVER;
+        else if (kind == 'V') code |= CELL_RIVER | CELL_VERTICAL;
+        else if (kind != 'S') return false;
+        grid.back().push_back(code);
+    }
+    if (grid.back().empty()) grid.pop_back();
+    if (grid.empty() || grid.size() * grid[0].size() > (size_t)MAX_CELLS) return false;
+    board = BoardState();
+    board.rows = grid.size();
+    board.cols = grid[0].size();
+    for (int y = 0; y < board.rows; ++y) {
+        if ((int)grid[y].size() != board.cols) return false;
+        for (int x = 0; x < board.cols; ++x) board.set_cell(x, y, grid[y][x]);
+    }
+    return true;
+}
+
+inline vector<pair<BoardState, int>> load_positions(const string& path) {
+    vector<pair<BoardState, int>> positions;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        BoardState board;
+        int player;
+        if (!parse_position(line, board, player)) throw runtime_error("bad position line: " + line);
+        positions.push_back({board, player});
+    }
+    return positions;
+}
+
+// default_start_board: two rows of stones for each side
+inline BoardState start_position(int rows, int cols) {
+    BoardState board;
+    board.rows = rows;
+    board.cols = cols;
+    int width = min(6, max(2, cols - 6));
+    int first = (cols - width) / 2;
+    for (int x = first; x < first + width; ++x) {
+        for (int y : {3, 4}) board.set_cell(x, y, 2);
+        for (int y : {rows - 5, rows - 4}) board.set_cell(x, y, 1);
+    }
+    return board;
+}
+
+// score columns the engine uses for a board width (score_cols_for)
+inline vector<int> score_cols_for(int cols) {
+    int start = max(0, (cols - 4) / 2);
+    return {start, start + 1, start + 2, start + 3};
+}
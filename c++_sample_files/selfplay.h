@@ -0,0 +1,145 @@
+// agent-vs-agent games under the rules of referee.h, for the native match
+// tools. include it after student_agent.cpp and referee.h.
+//
+// a game runs the way run_cli in gameEngine.py runs it: circle moves first,
+// each side has its own clock and loses when it runs out while thinking, a
+// move the referee rejects passes the turn, and the game is a draw once the
+// turn count passes max_turns
+#pragma once
+
+#include <functional>
+
+// one agent setup: the engine ("mcts" or "alphabeta"), optionally followed by
+// ",key=value" settings: threads, mode (root or tree), batch (playout batch),
+// uct_c, move_time (fixed seconds per move), playouts (per-move playout
+// limit) and node_cap. e.g. "mcts,threads=2,mode=tree" or "mcts,uct_c=1.0"
+struct AgentConfig {
+    string spec;
+    string engine = "mcts";
+    int threads = 1;
+    string mode = "root";
+    int batch = 1;
+    double uct_c = 0.0;      // 0: the agent's default
+    double move_time = 0.0;  // 0: plan from the clock
+    int playouts = 0;
+    size_t node_cap = 0;     // 0: the agent's default
+
+    static AgentConfig parse(const string& spec) {
+        AgentConfig config;
+        config.spec = spec;
+        istringstream in(spec);
+        string item;
+        getline(in, config.engine, ',');
+        while (getline(in, item, ',')) {
+            size_t eq = item.find('=');
+            string key = item.substr(0, eq), value = (eq == string::npos) ? "" : item.substr(eq + 1);
+            if (key == "threads") config.threads = stoi(value);
+            else if (key == "mode") config.mode = value;
+            else if (key == "batch") config.batch = stoi(value);
+            else if (key == "uct_c") config.uct_c = stod(value);
+            else if (key == "move_time") config.move_time = stod(value);
+            else if (key == "playouts") config.playouts = stoi(value);
+            else if (key == "node_cap") config.node_cap = stoul(value);
+            else throw invalid_argument("unknown agent setting \"" + item + "\" in " + spec);
+        }
+        // let the constructor and setters reject bad values now, not in a worker
+        config.make(CIRCLE);
+        return config;
+    }
+
+    unique_ptr<StudentAgent> make(Player side) const {
+        auto agent = make_unique<StudentAgent>(side, engine);
+        agent->set_parallel(threads, mode);
+        agent->set_playout_batch(batch);
+        if (uct_c > 0) agent->set_uct_c(uct_c);
+        agent->set_move_time(move_time);
+        agent->set_playout_limit(playouts);
+        if (node_cap) agent->set_node_cap(node_cap);
+        return agent;
+    }
+};
+
+struct GameSettings {
+    int rows = 13;
+    int cols = 12;
+    double time_per_player = 60.0;
+    int max_turns = 1000;
+};
+
+enum GameEnd {
+    END_WIN = 0,
+    END_TIMEOUT = 1,
+    END_TURN_LIMIT = 2
+};
+
+// per-side arrays are indexed by player, 0 circle and 1 square
+struct GameRecord {
+    int winner = -1;  // -1: draw
+    GameEnd end = END_TURN_LIMIT;
+    int turns = 0;
+    int moves[2] = {0, 0};
+    double think_time[2] = {0.0, 0.0};
+    int passes[2] = {0, 0};    // no move returned
+    int rejected[2] = {0, 0};  // moves the referee refused, each a pass too
+};
+
+static GameRecord play_game(const AgentConfig& circle, const AgentConfig& square, const GameSettings& settings) {
+    vector<int> score_cols = score_cols_for(settings.cols);
+    Referee referee(settings.rows, settings.cols, score_cols);
+    BoardState board = start_position(settings.rows, settings.cols);
+    unique_ptr<StudentAgent> agents[2] = {circle.make(CIRCLE), square.make(SQUARE)};
+    double clock[2] = {settings.time_per_player, settings.time_per_player};
+    GameRecord record;
+    int current = 0;
+    while (true) {
+        int winner = referee.winner(board);
+        if (winner >= 0) {
+            record.winner = winner;
+            record.end = END_WIN;
+            break;
+        }
+        auto start = chrono::steady_clock::now();
+        Move move = agents[current]->choose_board(board, score_cols, clock[current], clock[1 - current]);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        clock[current] -= seconds;
+        record.moves[current]++;
+        record.think_time[current] += seconds;
+        if (clock[current] <= 0) {
+            record.winner = 1 - current;
+            record.end = END_TIMEOUT;
+            break;
+        }
+        if (move.action.empty()) {
+            record.passes[current]++;
+        } else {
+            PackedMove packed = referee.pack(move);
+            if (packed != NO_MOVE && referee.is_legal(board, current, packed)) referee.apply(board, packed);
+            else record.rejected[current]++;
+        }
+        current = 1 - current;
+        if (++record.turns > settings.max_turns) break;
+    }
+    return record;
+}
+
+// plays games 0..n-1 on up to threads threads. play(i) plays game i;
+// finished(i, record) runs under a lock as each game ends and returns false
+// to stop handing out new games (games already running still finish)
+static void run_games(int n, int threads, const function<GameRecord(int)>& play, const function<bool(int, const GameRecord&)>& finished) {
+    atomic<int> next{0};
+    atomic<bool> stop{false};
+    mutex finished_mutex;
+    auto work = [&] {
+        while (!stop) {
+            int i = next++;
+            if (i >= n) break;
+            GameRecord record = play(i);
+            lock_guard<mutex> lock(finished_mutex);
+            if (!finished(i, record)) stop = true;
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(work);
+    work();
+    for (auto& th : pool) th.join();
+}
@@ -0,0 +1,146 @@
+// Head-to-head match of a candidate agent setup against a baseline, stopped
+// by a sequential probability ratio test.
+//
+//   ./sprt [options] <candidate> <baseline>
+//
+//   --elo0 E --elo1 E  H0: the candidate is elo0 stronger, H1: elo1 stronger
+//                      (default 0 and 10)
+//   --alpha A --beta B error rates of the test (default 0.05 each)
+//   --max-games N      stop without a decision after N games (default 10000)
+//   --threads N        games played at once (default: hardware threads)
+//   --time S           seconds on each player's clock (default 60)
+//   --max-turns N --rows R --cols C  as for tournament
+//
+// Agents take the settings of tournament (AgentConfig in selfplay.h), e.g.
+//
+//   ./sprt mcts,uct_c=1.0 mcts
+//   ./sprt --time 600 mcts,move_time=0.2 mcts,move_time=0.1
+//   ./sprt mcts,playouts=4000,batch=8 mcts,playouts=4000
+//
+// The log-likelihood ratio uses the normal approximation of the trinomial
+// (win/draw/loss) score, and the Elo estimate comes with a 95% interval.
+// Exits 0 when H1 is accepted, 1 when H0 is accepted, 2 without a decision.
+#define STUDENT_AGENT_NO_PYBIND
+#include "student_agent.cpp"
+#include "referee.h"
+#include "selfplay.h"
+#include <cstdio>
+#include <cstring>
+
+// expected score of a player elo points stronger
+static double elo_to_score(double elo) { return 1.0 / (1.0 + pow(10.0, -elo / 400.0)); }
+
+static double score_to_elo(double score) {
+    score = min(max(score, 1e-6), 1.0 - 1e-6);
+    return 400.0 * log10(score / (1.0 - score));
+}
+
+// wins, draws and losses of the candidate
+struct MatchScore {
+    int w = 0, d = 0, l = 0;
+
+    int games() const { return w + d + l; }
+    double mean() const { return (w + 0.5 * d) / games(); }
+
+    // variance of one game's score
+    double variance() const {
+        double m = mean();
+        return (w * (1 - m) * (1 - m) + d * (0.5 - m) * (0.5 - m) + l * m * m) / games();
+    }
+
+    double llr(double elo0, double elo1) const {
+        double var = variance();
+        if (games() == 0 || var <= 0) return 0.0;
+        double s0 = elo_to_score(elo0), s1 = elo_to_score(elo1);
+        return games() * (s1 - s0) * (2 * mean() - s0 - s1) / (2 * var);
+    }
+
+    // elo difference and its 95% interval
+    void elo(double& estimate, double& low, double& high) const {
+        double margin = 1.96 * sqrt(variance() / games());
+        estimate = score_to_elo(mean());
+        low = score_to_elo(mean() - margin);
+        high = score_to_elo(mean() + margin);
+    }
+};
+
+int main(int argc, char** argv) {
+    GameSettings settings;
+    double elo0 = 0.0, elo1 = 10.0, alpha = 0.05, beta = 0.05;
+    int max_games = 10000;
+    int threads = max(1u, thread::hardware_concurrency());
+    vector<string> specs;
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--elo0") && has_value) elo0 = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--elo1") && has_value) elo1 = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--alpha") && has_value) alpha = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--beta") && has_value) beta = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--max-games") && has_value) max_games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && has_value) threads = max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--time") && has_value) settings.time_per_player = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--max-turns") && has_value) settings.max_turns = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rows") && has_value) settings.rows = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cols") && has_value) settings.cols = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && specs.size() < 2) specs.push_back(argv[i]);
+        else {
+            specs.clear();
+            break;
+        }
+    }
+    if (specs.size() != 2 || max_games < 1 || elo1 <= elo0 || alpha <= 0 || beta <= 0 || alpha >= 1 || beta >= 1) {
+        fprintf(stderr, "usage: %s [--elo0 E] [--elo1 E] [--alpha A] [--beta B] [--max-games N] [--threads N] [--time S] [--max-turns N] [--rows R] [--cols C] <candidate> <baseline>\n", argv[0]);
+        return 3;
+    }
+    if (settings.rows * settings.cols > MAX_CELLS) {
+        fprintf(stderr, "board %dx%d is larger than %d cells\n", settings.rows, settings.cols, MAX_CELLS);
+        return 3;
+    }
+    AgentConfig configs[2];
+    try {
+        for (int a = 0; a < 2; ++a) configs[a] = AgentConfig::parse(specs[a]);
+    } catch (const exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 3;
+    }
+
+    double lower = log(beta / (1 - alpha)), upper = log((1 - beta) / alpha);
+    printf("candidate %s vs baseline %s\n", configs[0].spec.c_str(), configs[1].spec.c_str());
+    printf("H0: elo %+.1f  H1: elo %+.1f  alpha %.3f  beta %.3f  LLR bounds [%.2f, %.2f]\n", elo0, elo1, alpha, beta, lower, upper);
+
+    MatchScore score;
+    int rejected = 0;
+    int decision = 0;  // 1: H1 accepted, -1: H0 accepted
+    double llr = 0.0;
+    run_games(max_games, threads, [&](int game) {
+        // the candidate plays circle in even games
+        return play_game(configs[game % 2], configs[1 - game % 2], settings);
+    }, [&](int game, const GameRecord& record) {
+        int candidate = game % 2;
+        if (record.winner < 0) score.d++;
+        else if (record.winner == candidate) score.w++;
+        else score.l++;
+        rejected += record.rejected[0] + record.rejected[1];
+        llr = score.llr(elo0, elo1);
+        // games still running when the test decides are counted, the
+        // decision stays with the first bound crossed
+        if (!decision && llr >= upper) decision = 1;
+        if (!decision && llr <= lower) decision = -1;
+        double elo, low, high;
+        score.elo(elo, low, high);
+        fprintf(stderr, "\r%5d games  %d-%d-%d  elo %+7.1f [%+.1f, %+.1f]  LLR %+.2f   ",
+                score.games(), score.w, score.d, score.l, elo, low, high, llr);
+        return decision == 0;
+    });
+    fprintf(stderr, "\n");
+
+    double elo, low, high;
+    score.elo(elo, low, high);
+    printf("%d games: %d wins, %d draws, %d losses for the candidate (%.1f%%)\n",
+           score.games(), score.w, score.d, score.l, 100.0 * score.mean());
+    printf("elo %+.1f, 95%% interval [%+.1f, %+.1f]\n", elo, low, high);
+    printf("LLR %.2f: %s\n", llr, decision > 0 ? "H1 accepted, the candidate is stronger" :
+                                  decision < 0 ? "H0 accepted, the candidate is not stronger" : "no decision");
+    if (rejected) printf("warning: the referee refused %d moves\n", rejected);
+    return decision > 0 ? 0 : (decision < 0 ? 1 : 2);
+}
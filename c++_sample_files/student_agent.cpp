@@ -1,5 +1,9 @@
+// define STUDENT_AGENT_NO_PYBIND to include this file from a plain c++ program
+#ifndef STUDENT_AGENT_NO_PYBIND
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+#endif
 #include <string>
 #include <vector>
 #include <map>
@@ -12,10 +16,24 @@
 #include <memory>
 #include <chrono>
 #include <optional>
+#include <cstdint>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+#include <future>
+#include <fstream>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STUDENT_AGENT_X86 1
+#endif
 
 using namespace std;
 
+#ifndef STUDENT_AGENT_NO_PYBIND
 namespace py = pybind11;
+#endif
 
 struct Move {
     string action;
@@ -30,134 +48,1031 @@ static string get_key(const map<string, string>& m, const string& k) {
     return it == m.end() ? "" : it->second;
 }
 
-using BoardState = vector<vector<map<string, string>>>;
+using MapBoard = vector<vector<map<string, string>>>;
 
-struct Node {
+// player identity inside the engine, usable as a 0/1 index. the names
+// "circle" and "square" are only read and written at the python boundary
+enum Player : int8_t {
+    NO_PLAYER = -1,
+    CIRCLE = 0,
+    SQUARE = 1
+};
+
+// NO_PLAYER for any name other than "circle" and "square"
+static Player player_of(const string& pid) {
+    if (pid == "circle") return CIRCLE;
+    if (pid == "square") return SQUARE;
+    return NO_PLAYER;
+}
+static const char* player_name(Player p) { return (p == CIRCLE) ? "circle" : "square"; }
+static Player opponent_of(Player p) { return (p == CIRCLE) ? SQUARE : CIRCLE; }
+
+// cell codes: owner in the low two bits (0 empty, 1 circle, 2 square),
+// bit 2 set for the river side, bit 3 set for a vertical river
+const uint8_t CELL_EMPTY = 0;
+const uint8_t CELL_OWNER_MASK = 3;
+const uint8_t CELL_RIVER = 4;
+const uint8_t CELL_VERTICAL = 8;
+
+const int MAX_CELLS = 256;
+const int BB_WORDS = MAX_CELLS / 64;
+
+struct Bitboard {
+    uint64_t w[BB_WORDS] = {};
+
+    bool test(int i) const { return (w[i >> 6] >> (i & 63)) & 1ULL; }
+    void set(int i) { w[i >> 6] |= 1ULL << (i & 63); }
+    void reset(int i) { w[i >> 6] &= ~(1ULL << (i & 63)); }
+
+    int count() const {
+        int n = 0;
+        for (int k = 0; k < BB_WORDS; ++k) n += __builtin_popcountll(w[k]);
+        return n;
+    }
+
+    Bitboard& operator|=(const Bitboard& o) {
+        for (int k = 0; k < BB_WORDS; ++k) w[k] |= o.w[k];
+        return *this;
+    }
+    Bitboard& operator&=(const Bitboard& o) {
+        for (int k = 0; k < BB_WORDS; ++k) w[k] &= o.w[k];
+        return *this;
+    }
+
+    // calls f(i) for every set bit, lowest index first
+    template <typename F>
+    void for_each(F f) const {
+        for (int k = 0; k < BB_WORDS; ++k) {
+            uint64_t bits = w[k];
+            while (bits) {
+                f(k * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+};
+
+static Bitboard all_cells() {
+    Bitboard all;
+    for (int k = 0; k < BB_WORDS; ++k) all.w[k] = ~0ULL;
+    return all;
+}
+
+const Bitboard ALL_CELLS = all_cells();
+
+// zobrist keys: one per (cell, cell code), plus one xored in when square is to move
+struct ZobristKeys {
+    uint64_t cell[MAX_CELLS][16];
+    uint64_t square_to_move;
+
+    ZobristKeys() {
+        uint64_t seed = 0x9E3779B97F4A7C15ULL;
+        auto next = [&seed]() {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        };
+        for (int i = 0; i < MAX_CELLS; ++i) {
+            for (int code = 0; code < 16; ++code) {
+                cell[i][code] = (code == CELL_EMPTY) ? 0 : next();
+            }
+        }
+        square_to_move = next();
+    }
+};
+
+static const ZobristKeys ZOBRIST;
+
+const int MAX_SCORE_DIST = 32;
+
+// per player: own scoring cells, and the cells of the row in front of them
+// at the scoring columns. dist is the manhattan distance to the nearest own
+// scoring cell (capped at MAX_SCORE_DIST), closer[p][d] the cells with dist < d.
+// held[p] are the cells whose pieces get_all_moves never moves.
+// step_*[d] describe a one-cell step in direction d (dirs order of
+// get_all_moves): the index delta, the cells a step may start from without
+// leaving the board, and per player the landing cells outside the opponent's
+// scoring area that are closer than the cell the step came from.
+// neighbour[i][d] is the cell one step from i in direction d, -1 off the board
+struct ScoreMasks {
+    Bitboard score[2];
+    Bitboard near[2];
+    int8_t dist[2][MAX_CELLS];
+    Bitboard closer[2][MAX_SCORE_DIST + 1];
+    Bitboard held[2];
+    int step_delta[4];
+    Bitboard step_source[4];
+    Bitboard step_allowed[2][4];
+    int16_t neighbour[MAX_CELLS][4];
+};
+
+// packed board, one bit per cell (index y * cols + x) in each plane.
+// copying it is a flat memcpy, no heap traffic
+struct BoardState {
+    Bitboard stones[2];
+    Bitboard rivers[2];
+    Bitboard vertical;
+    // zobrist hash of the pieces, kept up to date by set_cell_at
+    uint64_t hash = 0;
+    int rows = 0;
+    int cols = 0;
+    // with masks attached, set_cell_at also keeps per player the number of
+    // own stones in the scoring area and of own pieces in the row before it
+    const ScoreMasks* masks = nullptr;
+    int8_t score_count[2] = {0, 0};
+    int8_t near_count[2] = {0, 0};
+
+    int index(int x, int y) const { return y * cols + x; }
+
+    bool is_empty_at(int i) const { return !(stones[0].test(i) || stones[1].test(i) || rivers[0].test(i) || rivers[1].test(i)); }
+    bool is_stone_at(int i) const { return stones[0].test(i) || stones[1].test(i); }
+    bool is_river_at(int i) const { return rivers[0].test(i) || rivers[1].test(i); }
+
+    bool is_empty(int x, int y) const { return is_empty_at(index(x, y)); }
+    bool is_stone(int x, int y) const { return is_stone_at(index(x, y)); }
+    bool is_river(int x, int y) const { return is_river_at(index(x, y)); }
+    bool is_vertical(int x, int y) const { return vertical.test(index(x, y)); }
+
+    // -1 when the cell is empty
+    int owner_at(int i) const {
+        if (stones[0].test(i) || rivers[0].test(i)) return 0;
+        if (stones[1].test(i) || rivers[1].test(i)) return 1;
+        return -1;
+    }
+    int owner(int x, int y) const { return owner_at(index(x, y)); }
+
+    uint8_t cell_at(int i) const {
+        int p = owner_at(i);
+        if (p < 0) return CELL_EMPTY;
+        uint8_t code = static_cast<uint8_t>(p + 1);
+        if (rivers[p].test(i)) {
+            code |= CELL_RIVER;
+            if (vertical.test(i)) code |= CELL_VERTICAL;
+        }
+        return code;
+    }
+    uint8_t cell(int x, int y) const { return cell_at(index(x, y)); }
+
+    void set_cell(int x, int y, uint8_t code) { set_cell_at(index(x, y), code); }
+
+    // +1 / -1 for whatever sits on i towards the scoring counters
+    void count_cell(int i, int delta) {
+        int p = owner_at(i);
+        if (p < 0) return;
+        if (stones[p].test(i) && masks->score[p].test(i)) score_count[p] += delta;
+        if (masks->near[p].test(i)) near_count[p] += delta;
+    }
+
+    void attach(const ScoreMasks* score_masks) {
+        masks = score_masks;
+        for (int p = 0; p < 2; ++p) {
+            Bitboard in_score = stones[p];
+            in_score &= masks->score[p];
+            Bitboard near = stones[p];
+            near |= rivers[p];
+            near &= masks->near[p];
+            score_count[p] = in_score.count();
+            near_count[p] = near.count();
+        }
+    }
+
+    void set_cell_at(int i, uint8_t code) {
+        if (!(code & CELL_OWNER_MASK)) code = CELL_EMPTY;
+        else if (!(code & CELL_RIVER)) code &= CELL_OWNER_MASK;
+        hash ^= ZOBRIST.cell[i][cell_at(i)] ^ ZOBRIST.cell[i][code];
+        if (masks) count_cell(i, -1);
+
+        stones[0].reset(i); stones[1].reset(i);
+        rivers[0].reset(i); rivers[1].reset(i);
+        vertical.reset(i);
+        int owner_bits = code & CELL_OWNER_MASK;
+        if (owner_bits == 0) return;
+        int p = owner_bits - 1;
+        if (code & CELL_RIVER) {
+            rivers[p].set(i);
+            if (code & CELL_VERTICAL) vertical.set(i);
+        } else {
+            stones[p].set(i);
+        }
+        if (masks) count_cell(i, +1);
+    }
+
+    // turns whatever sits on (x, y) stone side up, keeping its owner
+    void make_stone(int x, int y) {
+        uint8_t code = cell(x, y);
+        if (code != CELL_EMPTY) set_cell(x, y, code & CELL_OWNER_MASK);
+    }
+};
+
+// board size as the move generator sees it. FixedGeometry compiles a size
+// in, so bounds checks, cell indices and scoring rows fold to constants;
+// AnyGeometry reads them from the board. both give a fresh object per call
+template <int ROWS, int COLS>
+struct FixedGeometry {
+    static_assert(ROWS * COLS <= MAX_CELLS, "board does not fit a Bitboard");
+    static constexpr int rows = ROWS;
+    static constexpr int cols = COLS;
+
+    explicit FixedGeometry(const BoardState&) {}
+    static constexpr bool inside(int x, int y) { return x >= 0 && x < COLS && y >= 0 && y < ROWS; }
+    static constexpr int index(int x, int y) { return y * COLS + x; }
+    // the row player p scores on
+    static constexpr int score_row(int p) { return (p == 0) ? 2 : ROWS - 3; }
+};
+
+struct AnyGeometry {
+    int rows;
+    int cols;
+
+    AnyGeometry(int rows, int cols) : rows(rows), cols(cols) {}
+    explicit AnyGeometry(const BoardState& board) : rows(board.rows), cols(board.cols) {}
+    bool inside(int x, int y) const { return x >= 0 && x < cols && y >= 0 && y < rows; }
+    int index(int x, int y) const { return y * cols + x; }
+    int score_row(int p) const { return (p == 0) ? 2 : rows - 3; }
+};
+
+// what make_move overwrote: the previous contents of every cell it touched,
+// replayed in reverse by unmake_move
+struct UndoRecord {
+    int count = 0;
+    uint8_t cells[3];
+    uint8_t codes[3];
+};
+
+// batched step kernel: for n boards, the one-cell steps of pieces[i] onto
+// empty allowed cells, as one target bitboard per direction in
+// out[4 * i + d]. players[i] picks the allowed masks of board i. the
+// playouts of a batch call it once per ply. an avx2 version handles a whole
+// 256-cell plane per instruction, picked at startup when the cpu has it
+using StepKernel = void (*)(const ScoreMasks& masks, const int* players, const Bitboard* pieces, const Bitboard* occupied, int n, Bitboard* out);
+
+// cell i moves to i + delta, 0 < |delta| < 64 (boards are at most 16 wide)
+static Bitboard shift_cells(const Bitboard& b, int delta) {
+    Bitboard r;
+    if (delta > 0) {
+        for (int k = BB_WORDS - 1; k >= 0; --k) {
+            r.w[k] = (b.w[k] << delta) | (k > 0 ? b.w[k - 1] >> (64 - delta) : 0);
+        }
+    } else {
+        int s = -delta;
+        for (int k = 0; k < BB_WORDS; ++k) {
+            r.w[k] = (b.w[k] >> s) | (k + 1 < BB_WORDS ? b.w[k + 1] << (64 - s) : 0);
+        }
+    }
+    return r;
+}
+
+static void step_targets_scalar(const ScoreMasks& masks, const int* players, const Bitboard* pieces, const Bitboard* occupied, int n, Bitboard* out) {
+    for (int i = 0; i < n; ++i) {
+        for (int d = 0; d < 4; ++d) {
+            Bitboard from = pieces[i];
+            from &= masks.step_source[d];
+            Bitboard& to = out[4 * i + d];
+            to = shift_cells(from, masks.step_delta[d]);
+            to &= masks.step_allowed[players[i]][d];
+            for (int k = 0; k < BB_WORDS; ++k) to.w[k] &= ~occupied[i].w[k];
+        }
+    }
+}
+
+#ifdef STUDENT_AGENT_X86
+static_assert(BB_WORDS == 4, "the avx2 kernel holds a bitboard in one register");
+
+__attribute__((target("avx2")))
+static void step_targets_avx2(const ScoreMasks& masks, const int* players, const Bitboard* pieces, const Bitboard* occupied, int n, Bitboard* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < n; ++i) {
+        __m256i own = _mm256_loadu_si256((const __m256i*)pieces[i].w);
+        __m256i occ = _mm256_loadu_si256((const __m256i*)occupied[i].w);
+        for (int d = 0; d < 4; ++d) {
+            __m256i from = _mm256_and_si256(own, _mm256_loadu_si256((const __m256i*)masks.step_source[d].w));
+            int delta = masks.step_delta[d];
+            __m256i to;
+            if (delta > 0) {
+                // bits carried in from the word below
+                __m256i below = _mm256_blend_epi32(_mm256_permute4x64_epi64(from, 0x93), zero, 0x03);
+                to = _mm256_or_si256(_mm256_sll_epi64(from, _mm_cvtsi32_si128(delta)),
+                                     _mm256_srl_epi64(below, _mm_cvtsi32_si128(64 - delta)));
+            } else {
+                __m256i above = _mm256_blend_epi32(_mm256_permute4x64_epi64(from, 0x39), zero, 0xC0);
+                to = _mm256_or_si256(_mm256_srl_epi64(from, _mm_cvtsi32_si128(-delta)),
+                                     _mm256_sll_epi64(above, _mm_cvtsi32_si128(64 + delta)));
+            }
+            to = _mm256_and_si256(to, _mm256_loadu_si256((const __m256i*)masks.step_allowed[players[i]][d].w));
+            to = _mm256_andnot_si256(occ, to);
+            _mm256_storeu_si256((__m256i*)out[4 * i + d].w, to);
+        }
+    }
+}
+#endif
+
+static StepKernel pick_step_kernel() {
+#ifdef STUDENT_AGENT_X86
+    if (__builtin_cpu_supports("avx2")) return step_targets_avx2;
+#endif
+    return step_targets_scalar;
+}
+
+static const StepKernel step_targets = pick_step_kernel();
+
+// river-flow index. rivers of the same orientation that see each other
+// along their flow axis (only empty cells in between) form one chain; a
+// piece stepping onto any river of a chain can land on every empty cell
+// the chain's rivers flow over. flows stop short of the mover's opponent
+// scoring row, so chains and landings are kept per moving player.
+//
+// influence holds every cell the last rebuild looked at (the rivers and
+// every cell a flow passed or stopped on). a move that touches none of
+// them and leaves no river behind cannot change the index, anything else
+// marks it stale and the next lookup rebuilds it.
+struct RiverNetwork {
+    bool valid = false;
+    int16_t component[2][MAX_CELLS];
+    vector<Bitboard> landings[2];
+    Bitboard influence;
+
+    // blocked[p]: cells flows of player p's pieces may not enter
+    void rebuild(const BoardState& board, const Bitboard blocked[2]) {
+        influence = Bitboard();
+        Bitboard all_rivers = board.rivers[0];
+        all_rivers |= board.rivers[1];
+        influence |= all_rivers;
+
+        int stack[MAX_CELLS];
+        for (int p = 0; p < 2; ++p) {
+            landings[p].clear();
+            fill(begin(component[p]), end(component[p]), -1);
+            all_rivers.for_each([&](int start) {
+                if (component[p][start] >= 0 || blocked[p].test(start)) return;
+                int id = landings[p].size();
+                landings[p].emplace_back();
+                Bitboard& reach = landings[p].back();
+                int top = 0;
+                stack[top++] = start;
+                component[p][start] = id;
+                while (top > 0) {
+                    int cur = stack[--top];
+                    int cx = cur % board.cols, cy = cur / board.cols;
+                    bool vertical = board.vertical.test(cur);
+                    int dx = vertical ? 0 : 1, dy = vertical ? 1 : 0;
+                    for (int dir = -1; dir <= 1; dir += 2) {
+                        int nx = cx + dx * dir, ny = cy + dy * dir;
+                        while (nx >= 0 && nx < board.cols && ny >= 0 && ny < board.rows) {
+                            int next = board.index(nx, ny);
+                            if (blocked[p].test(next)) break;
+                            influence.set(next);
+                            if (board.is_empty(nx, ny)) {
+                                reach.set(next);
+                                nx += dx * dir;
+                                ny += dy * dir;
+                                continue;
+                            }
+                            if (board.is_river(nx, ny) && board.vertical.test(next) == vertical && component[p][next] < 0) {
+                                component[p][next] = id;
+                                stack[top++] = next;
+                            }
+                            break;
+                        }
+                    }
+                }
+            });
+        }
+        valid = true;
+    }
+
+    // call after make_move / unmake_move with the record they used
+    void note_move(const BoardState& board, const UndoRecord& undo) {
+        for (int k = 0; k < undo.count && valid; ++k) {
+            int i = undo.cells[k];
+            if (influence.test(i) || (board.cell_at(i) & CELL_RIVER)) valid = false;
+        }
+    }
+};
+
+// the only place the python-side board of string maps is read. the board
+// comes from python as is, so a size past MAX_CELLS, ragged rows and
+// unknown owners are rejected before anything is written to a bitboard
+static BoardState pack_board(const MapBoard& board) {
     BoardState state;
-    Node* parent = nullptr;
-    vector<unique_ptr<Node>> children;
+    state.rows = board.size();
+    state.cols = board.empty() ? 0 : board[0].size();
+    if (state.rows * state.cols > MAX_CELLS) {
+        throw invalid_argument("board of " + to_string(state.rows) + "x" + to_string(state.cols) + " cells is larger than " + to_string(MAX_CELLS));
+    }
+    for (int y = 0; y < state.rows; ++y) {
+        if ((int)board[y].size() != state.cols) {
+            throw invalid_argument("row " + to_string(y) + " has " + to_string(board[y].size()) + " cells, expected " + to_string(state.cols));
+        }
+        for (int x = 0; x < state.cols; ++x) {
+            const auto& cell = board[y][x];
+            if (cell.empty()) continue;
+            Player owner = player_of(get_key(cell, "owner"));
+            if (owner == NO_PLAYER) {
+                throw invalid_argument("bad owner \"" + get_key(cell, "owner") + "\" at row " + to_string(y) + ", column " + to_string(x));
+            }
+            uint8_t code = static_cast<uint8_t>(owner + 1);
+            if (get_key(cell, "side") == "river") {
+                code |= CELL_RIVER;
+                if (get_key(cell, "orientation") == "vertical") code |= CELL_VERTICAL;
+            }
+            state.set_cell(x, y, code);
+        }
+    }
+    return state;
+}
+
+// the numpy entry point: one byte per cell in row-major order, holding the
+// CELL_* code of the cell (owner + 1, CELL_RIVER, CELL_VERTICAL). the bytes
+// come from an arbitrary python array, so owner 3, river bits on an empty
+// cell and any other bit are rejected before they can index a bitboard
+static BoardState pack_cells(const uint8_t* cells, int rows, int cols) {
+    if (rows * cols > MAX_CELLS) throw invalid_argument("board larger than " + to_string(MAX_CELLS) + " cells");
+    BoardState state;
+    state.rows = rows;
+    state.cols = cols;
+    for (int i = 0; i < rows * cols; ++i) {
+        if (!cells[i]) continue;
+        int owner = cells[i] & CELL_OWNER_MASK;
+        if (owner == CELL_OWNER_MASK || owner == 0 || (cells[i] & ~(CELL_OWNER_MASK | CELL_RIVER | CELL_VERTICAL))) {
+            throw invalid_argument("bad cell code " + to_string(cells[i]) + " at row " + to_string(i / cols) + ", column " + to_string(i % cols));
+        }
+        state.set_cell_at(i, cells[i]);
+    }
+    return state;
+}
+
+// packed move: bits 0-1 kind, 2-3 orientation, 4-11 from, 12-19 to,
+// 20-27 pushed_to (cell indices as in BoardState::index)
+using PackedMove = uint32_t;
+
+const uint32_t MOVE_STEP = 0;
+const uint32_t MOVE_PUSH = 1;
+const uint32_t MOVE_FLIP = 2;
+const uint32_t MOVE_ROTATE = 3;
+
+const uint32_t ORIENT_NONE = 0;
+const uint32_t ORIENT_HORIZONTAL = 1;
+const uint32_t ORIENT_VERTICAL = 2;
+
+const PackedMove NO_MOVE = 0xFFFFFFFFu;
+
+static inline PackedMove pack_move(uint32_t kind, int from, int to, int pushed_to = 0, uint32_t orientation = ORIENT_NONE) {
+    return kind | (orientation << 2) | (static_cast<uint32_t>(from) << 4) |
+           (static_cast<uint32_t>(to) << 12) | (static_cast<uint32_t>(pushed_to) << 20);
+}
+
+static inline uint32_t move_kind(PackedMove m) { return m & 3u; }
+static inline uint32_t move_orientation(PackedMove m) { return (m >> 2) & 3u; }
+static inline int move_from(PackedMove m) { return (m >> 4) & 0xFFu; }
+static inline int move_to(PackedMove m) { return (m >> 12) & 0xFFu; }
+static inline int move_pushed_to(PackedMove m) { return (m >> 20) & 0xFFu; }
+
+// the python-facing Move, built only when a move leaves choose()
+static Move unpack_move(PackedMove m, int cols) {
+    if (m == NO_MOVE) return {};
+    static const char* actions[4] = {"move", "push", "flip", "rotate"};
+    static const char* orientations[3] = {"", "horizontal", "vertical"};
     Move move;
+    move.action = actions[move_kind(m)];
+    move.from = {move_from(m) % cols, move_from(m) / cols};
+    move.to = {move_to(m) % cols, move_to(m) / cols};
+    if (move_kind(m) == MOVE_PUSH) move.pushed_to = {move_pushed_to(m) % cols, move_pushed_to(m) / cols};
+    move.orientation = orientations[move_orientation(m)];
+    return move;
+}
+
+static uint64_t position_key(const BoardState& board, Player pid) {
+    return board.hash ^ ((pid == CIRCLE) ? 0 : ZOBRIST.square_to_move);
+}
+
+using NodeIndex = uint32_t;
+
+struct Edge {
+    PackedMove move;
+    NodeIndex child;
+};
+
+// nodes live in the agent's arena and are found through the node table keyed
+// by position_key, so a position reached through different move orders is one
+// node with several parents
+struct Node {
+    BoardState state;
+    uint64_t key = 0;
+    vector<Edge> children;
     
-    int wins = 0;
-    int playouts = 0;
+    // counters are atomic so tree-parallel threads can update them without
+    // holding the node lock
+    atomic<int> wins{0};
+    atomic<int> playouts{0};
     
-    string pid;
-    vector<Move> untried_moves;
-    bool is_fully_expanded = false;
+    Player pid = CIRCLE;
+    vector<PackedMove> untried_moves;
+    atomic<bool> is_fully_expanded{false};
     bool is_terminal = false;
-    string terminal_result = "";
+    Player terminal_result = NO_PLAYER;
+
+    // guards children and untried_moves once the node is shared
+    mutex mtx;
+
+    // clears a recycled slot but keeps the vectors' capacity
+    void reset() {
+        key = 0;
+        children.clear();
+        wins = 0;
+        playouts = 0;
+        pid = CIRCLE;
+        untried_moves.clear();
+        is_fully_expanded = false;
+        is_terminal = false;
+        terminal_result = NO_PLAYER;
+    }
+
+    // moves other's contents into this slot (nodes themselves cannot move)
+    void take(Node& other) {
+        state = other.state;
+        key = other.key;
+        children.swap(other.children);
+        wins = other.wins.load();
+        playouts = other.playouts.load();
+        pid = other.pid;
+        untried_moves.swap(other.untried_moves);
+        is_fully_expanded = other.is_fully_expanded.load();
+        is_terminal = other.is_terminal;
+        terminal_result = other.terminal_result;
+    }
+};
+
+// slab pool of nodes. blocks are never freed or moved, so a Node* stays valid
+// until reset(), which just rewinds the bump index
+struct NodeArena {
+    static const int BLOCK_BITS = 12;
+    static const NodeIndex BLOCK_SIZE = 1u << BLOCK_BITS;
+
+    vector<unique_ptr<Node[]>> blocks;
+    atomic<NodeIndex> used{0};
+
+    Node& operator[](NodeIndex i) { return blocks[i >> BLOCK_BITS][i & (BLOCK_SIZE - 1)]; }
+    size_t size() const { return used; }
+    void reset() { used = 0; }
+
+    // alloc may run while other threads index the arena, so the block list
+    // must not reallocate during a tree-parallel search
+    void reserve(size_t nodes) { blocks.reserve(nodes / BLOCK_SIZE + 2); }
+
+    NodeIndex alloc() {
+        NodeIndex i = used;
+        if (i == blocks.size() * BLOCK_SIZE) blocks.emplace_back(new Node[BLOCK_SIZE]);
+        (*this)[i].reset();
+        used = i + 1;
+        return i;
+    }
+
+    void swap(NodeArena& other) {
+        blocks.swap(other.blocks);
+        NodeIndex n = used;
+        used = other.used.load();
+        other.used = n;
+    }
+};
+
+// one search tree: the node arena plus the table that finds nodes by position.
+// table_mutex serialises lookups and allocation when threads share the tree
+struct SearchTree {
+    NodeArena arena;
+    NodeArena spare_arena;
+    unordered_map<uint64_t, NodeIndex> node_table;
+    mutex table_mutex;
+
+    void clear() {
+        node_table.clear();
+        arena.reset();
+    }
+};
+
+// one playout of a batch advancing in lock-step with the others
+struct PlayoutLane {
+    BoardState state;
+    Player player;
+    RiverNetwork rivers;
+    bool done;
+    double result;
+};
+
+// a leaf handed to the playout batch with the path that reached it
+struct PendingPlayout {
+    vector<Node*> path;
+    Node* start;
+};
+
+// what one search thread did, summed over the threads after the search.
+// times are thread-seconds per phase; move generation is timed inside
+// expansion and playouts, so it is also part of those two
+struct SearchStats {
+    long long expansions = 0;
+    long long playouts = 0;
+    long long playout_plies = 0;
+    long long depth_sum = 0;       // over the leaves the search reached
+    int max_depth = 0;
+    double select_time = 0.0;
+    double expand_time = 0.0;
+    double playout_time = 0.0;
+    double backprop_time = 0.0;
+    double move_gen_time = 0.0;
+
+    void add(const SearchStats& other) {
+        expansions += other.expansions;
+        playouts += other.playouts;
+        playout_plies += other.playout_plies;
+        depth_sum += other.depth_sum;
+        max_depth = max(max_depth, other.max_depth);
+        select_time += other.select_time;
+        expand_time += other.expand_time;
+        playout_time += other.playout_time;
+        backprop_time += other.backprop_time;
+        move_gen_time += other.move_gen_time;
+    }
+};
+
+// seconds since mark, and moves mark up to now
+static double lap(chrono::steady_clock::time_point& mark) {
+    auto now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - mark).count();
+    mark = now;
+    return seconds;
+}
+
+// per-thread search scratch, so playouts never share an rng or river index
+struct SearchWorker {
+    mt19937 rng;
+    RiverNetwork move_gen_rivers;
+    vector<PackedMove> playout_moves, reducing_moves;
+    vector<PlayoutLane> lanes;
+    vector<int> lane_players;
+    vector<Bitboard> lane_pieces, lane_occupied, lane_steps;
+    vector<PendingPlayout> pending;
+    int queued = 0;
+    unsigned rounds = 0;
+    vector<Node*> batch_nodes;
+    vector<double> batch_results;
+    vector<Node*> path;
+    long long iterations = 0;
+    long long tt_lookups = 0, tt_hits = 0;
+    SearchStats stats;
+};
+
+// root statistics of one candidate move, summed over trees in root-parallel mode
+struct RootStat {
+    PackedMove move;
+    int wins;
+    int playouts;
+};
+
+enum ParallelMode {
+    PARALLEL_ROOT = 0,  // independent trees per thread, merged at the root
+    PARALLEL_TREE = 1   // one shared tree with virtual loss
+};
+
+enum SearchEngine {
+    ENGINE_MCTS = 0,
+    ENGINE_ALPHABETA = 1
+};
+
+// splits the remaining clock into a budget for one move. the search may stop
+// after soft seconds once the best root move has settled and never runs past
+// hard seconds, both counted from the moment choose was called
+struct TimeManager {
+    double reserve = 1.0;           // seconds never spent, covers python overhead
+    double min_time = 0.02;
+    double max_fraction = 0.25;     // hard budget as a share of the usable clock
+    int expected_moves = 80;        // our moves in a typical game
+    int min_moves_left = 20;
+
+    // moves_played: our moves so far. criticality >= 1 scales the budget up
+    // for positions close to being decided
+    void plan(double remaining, double opponent_remaining, int moves_played, double criticality, double& soft, double& hard) const {
+        // on a short clock the reserve and the floor shrink with it, so a
+        // move never takes a fixed slice the clock no longer has
+        double usable = max(0.0, remaining - min(reserve, 0.5 * remaining));
+        // a game that outlasts expected_moves is assumed to run on for as
+        // long again, so the clock shrinks polynomially instead of by a
+        // fixed share per move and long games do not run it down to nothing
+        int moves_left = max({min_moves_left, expected_moves - moves_played, moves_played});
+        double floor = min(min_time, usable / moves_left);
+        double budget = usable / moves_left * criticality;
+        // spend a little more when ahead on the clock, a little less when behind
+        if (opponent_remaining > 0) budget *= min(1.25, max(0.8, remaining / opponent_remaining));
+        hard = max(floor, min(budget * 3.0, usable * max_fraction));
+        soft = max(floor, min(budget, hard));
+    }
+};
+
+// deadlines and early-stop state of one search, shared by its threads.
+// only the controlling thread looks at the root, the others watch stop
+struct SearchClock {
+    chrono::steady_clock::time_point start;
+    double soft = 0.1;
+    double hard = 0.1;
+    atomic<bool> stop{false};
+    int start_visits = 0;
+    // stop once the tree holds this many nodes (0: no limit)
+    size_t node_limit = 0;
+    // a thread stops once the root of its tree has this many more playouts
+    // than when it started (0: no limit)
+    int playout_limit = 0;
+    // a new best child must lead the old one by more than this many visits to
+    // count as a change; covers virtual loss still in flight
+    int slack = 0;
+    PackedMove last_best = NO_MOVE;
+    double last_change = 0.0;
+
+    double elapsed() const {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
 };
 
 class StudentAgent {
 private:
-    string side;
-    string opponent_side;
+    Player side;
+    Player opponent_side;
     random_device rd;
     mt19937 gen;
     int board_rows = 12;
     int board_cols = 13;
+    RiverNetwork move_gen_rivers;
+
+    // scoring masks every searched board is attached to, built for the
+    // geometry and score columns below
+    ScoreMasks score_masks;
+    int masks_rows = -1, masks_cols = -1;
+    vector<int> masks_score_cols;
+    // set by prepare_board once score_masks are built for the board it
+    // adopted. the lookups below trust the tables only while this holds
+    bool masks_ready = false;
+
+    // move generator and playouts compiled for the board size prepare_board
+    // last saw, see pick_geometry
+    using MoveGenFn = vector<PackedMove> (StudentAgent::*)(const BoardState&, Player, const vector<int>&, RiverNetwork&);
+    using PlayoutsFn = void (StudentAgent::*)(SearchWorker&, Node* const*, int, const vector<int>&, double*);
+    MoveGenFn move_gen_for_size = &StudentAgent::get_all_moves_in<AnyGeometry>;
+    PlayoutsFn playouts_for_size = &StudentAgent::simulate_playouts_in<AnyGeometry>;
+
+    // every position reached by the search, keyed by position_key. kept
+    // between choose calls so the next search can start from the subtree
+    // that matches the board it is given
+    SearchTree tree;
+    // extra trees for root-parallel threads, rebuilt every search
+    vector<unique_ptr<SearchTree>> helper_trees;
+    size_t node_cap = 200000;
+    int num_threads = 1;
+    ParallelMode parallel_mode = PARALLEL_ROOT;
+    // leaves each search thread plays out together, see run_search
+    int playout_batch = 1;
+    long long last_tt_lookups = 0, last_tt_hits = 0, last_tt_nodes = 0;
+    long long last_reused_playouts = 0;
+    size_t last_reused_nodes = 0;
+    long long last_playouts = 0;
+    // telemetry of the last mcts search, see get_last_search_stats
+    SearchStats last_stats;
+    size_t last_memory_bytes = 0;
+    int last_threads = 1;
+    // one json line per mcts search when open, see set_search_log
+    ofstream search_log;
+
+    // search started by choose_async, collected by result
+    future<Move> pending;
+
+    SearchEngine engine = ENGINE_MCTS;
+    // alpha-beta: scores are from the side to move, wins are AB_WIN - ply so
+    // faster wins score higher
+    static const int AB_WIN = 1000000;
+    static const int AB_INF = 2 * AB_WIN;
+    static const int AB_MAX_DEPTH = 64;
+    static const int AB_ASPIRATION = 50;
+    long long ab_nodes = 0;
+    bool ab_abort = false;
+
+    // move ordering. hash_moves remembers the best move found at a position,
+    // killers the last two quiet moves that caused a cutoff at each ply, and
+    // history scores quiet (from, to) pairs by how often they cut off
+    struct HashMove {
+        uint64_t key = 0;
+        PackedMove move = NO_MOVE;
+    };
+    static const int HASH_MOVE_BITS = 16;
+    vector<HashMove> hash_moves = vector<HashMove>(1 << HASH_MOVE_BITS);
+    PackedMove killers[AB_MAX_DEPTH + 1][2];
+    vector<int> history = vector<int>(2 * MAX_CELLS * MAX_CELLS, 0);
+    int last_ab_depth = 0;
+    int last_ab_score = 0;
+    long long last_ab_nodes = 0;
+
+    // background search on the opponent's time, from the position after our
+    // last move. stopped through ponder_clock before anything touches the tree.
+    // the ponder thread writes nothing the stats getters read except
+    // last_ponder_playouts, stored once its run_search has returned
+    bool pondering = false;
+    thread ponder_thread;
+    SearchClock ponder_clock;
+    atomic<long long> last_ponder_playouts{0};
 
     // MANUAL CHANGE 6
-    const double time_limit = 0.1; 
-    const double UCT_C = 1.414;
+    double time_limit = 0.1; 
+    // search every move for time_limit, whatever the clocks say
+    bool fixed_move_time = false;
+    // per-move budget, planned by choose from the clocks (time_limit without them)
+    TimeManager time_manager;
+    double soft_limit = 0.1;
+    double hard_limit = 0.1;
+    double last_time_used = 0.0;
+    int playout_limit = 0;
+    double uct_c = 1.414;
+    const int VIRTUAL_LOSS = 3;
     int turn_count = 0;
     
 
 public:
-    explicit StudentAgent(string s); 
+    // engine is "mcts" or "alphabeta"
+    explicit StudentAgent(Player s, const string& engine_name = "mcts");
+    // by name, for the python binding
+    explicit StudentAgent(const string& s, const string& engine_name = "mcts") : StudentAgent(player_of(s), engine_name) {}
+    ~StudentAgent();
 
     bool is_inside_board(int x, int y) {
         return x >= 0 && x < board_cols && y >= 0 && y < board_rows;
     }
 
-    bool present_in_scoring(int x, int y, const string& pid, const vector<int>& score_cols) {
+    // the lookups below read score_masks once prepare_board has built them.
+    // they take the score columns of the last prepare_board, which every
+    // caller within a move passes, so they are not compared again per probe
+
+    // whether cell i is in player p's scoring area
+    bool in_scoring_area(int i, int p, const vector<int>& score_cols) {
+        if (masks_ready) return score_masks.score[p].test(i);
+        return present_in_scoring(i % board_cols, i / board_cols, Player(p), score_cols);
+    }
+
+    // manhattan distance from cell i to player p's nearest scoring cell
+    int closest_score_dist_at(int i, int p, const vector<int>& score_cols) {
+        if (masks_ready && score_masks.dist[p][i] < MAX_SCORE_DIST) return score_masks.dist[p][i];
+        return get_closest_score_dist(i % board_cols, i / board_cols, Player(p), score_cols, board_rows);
+    }
+
+    bool present_in_scoring(int x, int y, Player pid, const vector<int>& score_cols) {
         if (!is_inside_board(x,y) || score_cols.empty()) {
             return false;
         }
+        if (masks_ready) return score_masks.score[pid].test(y * board_cols + x);
 
         bool present_in_col = find(score_cols.begin(), score_cols.end(), x) != score_cols.end();
 
-        bool present_in_row = (pid == "circle") ? (y == 2) : (y == board_rows - 3);
+        bool present_in_row = (pid == CIRCLE) ? (y == 2) : (y == board_rows - 3);
         return present_in_col && present_in_row;
     }
 
-    void identify_river_motion(vector<Move>& moves, const BoardState& board, int start_x, int start_y, int curr_x, int curr_y, const string& pid, const vector<int>& score_cols, set<pair<int, int>>& visited) {
-        if (!is_inside_board(curr_x, curr_y) || present_in_scoring(curr_x, curr_y, (pid == side) ? opponent_side : side, score_cols)) return;
-        visited.insert({curr_x, curr_y});
-        const auto& cell = board[curr_y][curr_x];
-        if (cell.empty() || get_key(cell, "side") != "river") return;
-        
-        string current_orientation = get_key(cell, "orientation");
-        int dx = (current_orientation == "horizontal") ? 1 : 0;
-        int dy = (current_orientation == "vertical") ? 1 : 0;
-        
-        int dir = -1;
-        int next_x = curr_x + (dx * dir), next_y = curr_y + (dy * dir);
-        while (is_inside_board(next_x, next_y)) {
-            if (present_in_scoring(next_x, next_y, (pid == side) ? opponent_side : side, score_cols)) break;
-            const auto& next_cell = board[next_y][next_x];
-            if (next_cell.empty()) {
-                moves.push_back({"move", {start_x, start_y}, {next_x, next_y}, {}, ""});
-            } 
-            else if (get_key(next_cell, "side") == "river") {
-                if (get_key(next_cell, "orientation") == current_orientation && visited.find({next_x, next_y}) == visited.end()) {
-                    identify_river_motion(moves, board, start_x, start_y, next_x, next_y, pid, score_cols, visited);
+    // own scoring cells of both players
+    template <typename Geo>
+    void scoring_cells(const Geo& geo, const vector<int>& score_cols, Bitboard cells[2]) {
+        for (int p = 0; p < 2; ++p) {
+            cells[p] = Bitboard();
+            int row = geo.score_row(p);
+            for (int sx : score_cols) {
+                if (geo.inside(sx, row)) cells[p].set(geo.index(sx, row));
+            }
+        }
+    }
+
+    void scoring_cells(const vector<int>& score_cols, Bitboard cells[2]) {
+        scoring_cells(AnyGeometry(board_rows, board_cols), score_cols, cells);
+    }
+
+    void refresh_rivers(const BoardState& board, const vector<int>& score_cols, RiverNetwork& rivers) {
+        if (rivers.valid) return;
+        Bitboard cells[2], blocked[2];
+        scoring_cells(AnyGeometry(board), score_cols, cells);
+        blocked[0] = cells[1];
+        blocked[1] = cells[0];
+        rivers.rebuild(board, blocked);
+    }
+
+    // the flow, step and push moves of player p's piece at (x, y) that land
+    // the piece itself on a cell in filter, in get_all_moves order.
+    // scoring[q] holds player q's scoring cells. without plain_steps the
+    // one-cell steps onto empty cells are left out (the step kernel makes them)
+    template <typename Geo, typename Emit>
+    void for_each_step_or_push(const Geo& geo, const BoardState& board, int p, const Bitboard scoring[2], int x, int y, RiverNetwork& rivers, const Bitboard& filter, bool plain_steps, Emit&& emit) {
+        static const pair<int, int> dirs[4] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
+        int opp = 1 - p;
+        const int16_t* river_component = rivers.component[p];
+        int from = geo.index(x, y);
+        bool piece_is_stone = board.is_stone_at(from);
+
+        // every chain next to the piece contributes its landing cells once;
+        // plain steps onto adjacent empty cells are emitted below. a piece
+        // never enters a river on a scoring cell of either side, while a plain
+        // step may move onto an own scoring cell and only the opponent's are
+        // closed to it
+        Bitboard flow_targets;
+        bool has_flow = false;
+        for (auto const& [dx, dy] : dirs) {
+            int nx = x + dx, ny = y + dy;
+            if (!geo.inside(nx, ny) || scoring[opp].test(geo.index(nx, ny)) || scoring[p].test(geo.index(nx, ny))) continue;
+            if (board.is_river_at(geo.index(nx, ny)) && river_component[geo.index(nx, ny)] >= 0) {
+                flow_targets |= rivers.landings[p][river_component[geo.index(nx, ny)]];
+                has_flow = true;
+            }
+        }
+        if (has_flow) {
+            for (auto const& [dx, dy] : dirs) {
+                int nx = x + dx, ny = y + dy;
+                if (geo.inside(nx, ny) && board.is_empty_at(geo.index(nx, ny)) && !scoring[opp].test(geo.index(nx, ny))) {
+                    flow_targets.reset(geo.index(nx, ny));
                 }
-                break;
-            } 
-            else {
-                break;
             }
-            next_x += (dx * dir);
-            next_y += (dy * dir);
-        }
-        dir = 1;
-        next_x = curr_x + (dx * dir), next_y = curr_y + (dy * dir);
-        while (is_inside_board(next_x, next_y)) {
-            if (present_in_scoring(next_x, next_y, (pid == side) ? opponent_side : side, score_cols)) break;
-            const auto& next_cell = board[next_y][next_x];
-            if (next_cell.empty()) {
-                moves.push_back({"move", {start_x, start_y}, {next_x, next_y}, {}, ""});
-            } 
-            else if (get_key(next_cell, "side") == "river") {
-                if (get_key(next_cell, "orientation") == current_orientation && visited.find({next_x, next_y}) == visited.end()) {
-                    identify_river_motion(moves, board, start_x, start_y, next_x, next_y, pid, score_cols, visited);
+            flow_targets &= filter;
+            flow_targets.for_each([&](int to) {
+                emit(pack_move(MOVE_STEP, from, to));
+            });
+        }
+
+        for (auto const& [dx, dy] : dirs) {
+            if (!plain_steps) break;
+            int nx = x + dx, ny = y + dy;
+            if (!geo.inside(nx, ny) || scoring[opp].test(geo.index(nx, ny))) continue;
+            if (board.is_empty_at(geo.index(nx, ny)) && filter.test(geo.index(nx, ny))) emit(pack_move(MOVE_STEP, from, geo.index(nx, ny)));
+        }
+
+        // pushes: a stone pushes the neighbour one cell on, a river pushes a
+        // neighbouring stone along its flow axis onto any empty cell it reaches
+        for (auto const& [dx, dy] : dirs) {
+            int nx = x + dx, ny = y + dy;
+            if (!geo.inside(nx, ny) || board.is_empty_at(geo.index(nx, ny)) || !filter.test(geo.index(nx, ny))) continue;
+
+            int pushed_owner = board.owner_at(geo.index(nx, ny));
+            if (piece_is_stone) {
+                int nx2 = x + 2*dx, ny2 = y + 2*dy;
+                if (geo.inside(nx2, ny2) && board.is_empty_at(geo.index(nx2, ny2)) &&
+                    !(pushed_owner==opp) && scoring[p].test(geo.index(nx2, ny2)) &&
+                    !(pushed_owner==opp) && scoring[opp].test(geo.index(nx2, ny2)) &&
+                    !(pushed_owner==p) && scoring[opp].test(geo.index(nx2, ny2))) {
+                    emit(pack_move(MOVE_PUSH, from, geo.index(nx, ny), geo.index(nx2, ny2)));
+                }
+            } else {
+                if (board.is_stone_at(geo.index(nx, ny))) {
+                    bool vertical = board.vertical.test(from);
+                    int push_dx = vertical ? 0 : 1, push_dy = vertical ? 1 : 0;
+                    for (int dir = -1; dir <= 1; dir += 2) {
+                        int cur_px = nx + push_dx * dir, cur_py = ny + push_dy * dir;
+                        while(geo.inside(cur_px, cur_py)) {
+                            if ( (pushed_owner==opp) && scoring[p].test(geo.index(cur_px, cur_py))) break;
+                            if ( (pushed_owner==opp) && scoring[opp].test(geo.index(cur_px, cur_py))) break;
+                            if ( (pushed_owner==p) && scoring[opp].test(geo.index(cur_px, cur_py))) break;
+                            if(board.is_empty_at(geo.index(cur_px, cur_py))) emit(pack_move(MOVE_PUSH, from, geo.index(nx, ny), geo.index(cur_px, cur_py)));
+                            else break;
+                            cur_px += push_dx * dir; cur_py += push_dy * dir;
+                        }
+                    }
                 }
-                break;
-            } 
-            else {
-                break;
             }
-            next_x += (dx * dir);
-            next_y += (dy * dir);
         }
     }
 
+    vector<PackedMove> get_all_moves(const BoardState& board, Player pid, const vector<int>& score_cols) {
+        move_gen_rivers.valid = false;
+        return get_all_moves(board, pid, score_cols, move_gen_rivers);
+    }
 
-    vector<Move> get_all_moves(const BoardState& board, const string& pid, const vector<int>& score_cols) {
-        vector<Move> moves;
-        vector<pair<int, int>> dirs = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
-        string current_opponent_side = (pid == this->side) ? this->opponent_side : this->side;
+    // rivers must describe board (or be marked invalid), it is rebuilt on demand
+    vector<PackedMove> get_all_moves(const BoardState& board, Player pid, const vector<int>& score_cols, RiverNetwork& rivers) {
+        // a board prepare_board has not seen may have another size
+        if (board.rows != board_rows || board.cols != board_cols) return get_all_moves_in<AnyGeometry>(board, pid, score_cols, rivers);
+        return (this->*move_gen_for_size)(board, pid, score_cols, rivers);
+    }
 
-        set<pair<int, int>> fixed_positions;
-        set<pair<int, int>> conditionally_fixed_positions;
+    template <typename Geo>
+    vector<PackedMove> get_all_moves_in(const BoardState& board, Player pid, const vector<int>& score_cols, RiverNetwork& rivers) {
+        Geo geo(board);
+        vector<PackedMove> moves;
+        int p = pid;
+        int opp = 1 - p;
 
-        if (pid == "circle") {
-            fixed_positions = {{3, 10}, {3, 11}, {8, 10}, {8, 11}};
-            conditionally_fixed_positions = {{4, 9}, {5, 9}, {6, 9}, {7, 9}};
-        } else {
-            fixed_positions = {{3, 2}, {3, 1}, {8, 2}, {8, 1}};
-            conditionally_fixed_positions = {{4, 3}, {5, 3}, {6, 3}, {7, 3}};
-        }
+        // fixed: x in {3, 8} on the two back rows, conditionally fixed: x in 4..7 on the front row
+        int fixed_row_a = (p == 0) ? 10 : 2;
+        int fixed_row_b = (p == 0) ? 11 : 1;
+        int conditional_row = (p == 0) ? 9 : 3;
 
-        for (int y = 0; y < board_rows; ++y) {
-            for (int x = 0; x < board_cols; ++x) {
-                const auto& cell = board[y][x];
-                if (cell.empty() || get_key(cell, "owner") != pid) continue;
+        refresh_rivers(board, score_cols, rivers);
+        Bitboard scoring[2];
+        scoring_cells(geo, score_cols, scoring);
+
+        for (int y = 0; y < geo.rows; ++y) {
+            for (int x = 0; x < geo.cols; ++x) {
+                int from = geo.index(x, y);
+                if (board.owner_at(from) != p) continue;
 
-                string piece_side = get_key(cell, "side");
+                bool piece_is_stone = board.is_stone_at(from);
 
-                if (fixed_positions.count({x, y})) {
+                if ((x == 3 || x == 8) && (y == fixed_row_a || y == fixed_row_b)) {
 
 
                     // MANUAL CHANGE 2;
@@ -172,7 +1087,7 @@ public:
                     continue;
                 }
 
-                if (conditionally_fixed_positions.count({x, y})) {
+                if (x >= 4 && x <= 7 && y == conditional_row) {
 
                     // MANUAL CHANGE 3
 
@@ -201,116 +1116,30 @@ public:
                 // moves for those peices that are already in the scoring area
                 // flip if river
                 // if stone move horizontally making sure it is in score area for me, not in opps score and board is empty 
-                if (present_in_scoring(x, y, pid, score_cols)) {
-                    if (piece_side == "river") {
-                        moves.push_back({"flip", {x, y}, {x, y}, {}, ""});
-                    } else if (piece_side == "stone") {
+                if (scoring[p].test(from)) {
+                    if (!piece_is_stone) {
+                        moves.push_back(pack_move(MOVE_FLIP, from, from));
+                    } else {
                         for (int dx : {-1, 1}) {
                             int nx = x + dx;
-                            if (is_inside_board(nx, y) && present_in_scoring(nx, y, pid, score_cols) && !present_in_scoring(nx, y, current_opponent_side, score_cols) && board[y][nx].empty()) {
-                                moves.push_back({"move", {x, y}, {nx, y}, {}, ""});
+                            if (geo.inside(nx, y) && scoring[p].test(geo.index(nx, y)) && !scoring[opp].test(geo.index(nx, y)) && board.is_empty_at(geo.index(nx, y))) {
+                                moves.push_back(pack_move(MOVE_STEP, from, geo.index(nx, y)));
                             }
                         }
                     }
                     continue;
                 }
 
-                // does the river flow movements
-                // ignores a new pos if 
-                /*
-                    not in valid boaard pos or is gonna enter opps score area or is already in my score area dont move
-                */
-                for (auto const& [dx, dy] : dirs) {
-                    int nx = x + dx, ny = y + dy;
-
-
-                    // MANUAL CHANGE 1
-
-                    if (!is_inside_board(nx, ny) || present_in_scoring(nx, ny, current_opponent_side, score_cols) || present_in_scoring(nx, ny, pid, score_cols)) continue;
-                    // if (!is_inside_board(nx, ny) || present_in_scoring(nx, ny, current_opponent_side, score_cols)) continue;
-                    
-                    
-                    
-                    const auto& next_cell = board[ny][nx];
-                    // if (next_cell.empty()) moves.push_back({"move", {x, y}, {nx, ny}, {}, ""});
-                    if (get_key(next_cell, "side") == "river") {
-                        set<pair<int, int>> visited;
-                        identify_river_motion(moves, board, x, y, nx, ny, pid, score_cols, visited);
-                    
-                    }
-                }
-
-                for (auto const& [dx, dy] : dirs) {
-                    int nx = x + dx, ny = y + dy;
-
-
-                    // MANUAL CHANGE 1
-
-                    // if (!is_inside_board(nx, ny) || present_in_scoring(nx, ny, current_opponent_side, score_cols) || present_in_scoring(nx, ny, pid, score_cols)) continue;
-                    if (!is_inside_board(nx, ny) || present_in_scoring(nx, ny, current_opponent_side, score_cols)) continue;
-                    
-                    
-                    
-                    const auto& next_cell = board[ny][nx];
-                    if (next_cell.empty()) moves.push_back({"move", {x, y}, {nx, ny}, {}, ""});
-                }
-
-                /*
-                now for push
-                we wanna check the following for the guy we wanna push
-                    if i am a stone:
-                        bro should not be a river
-                        bro should not be in opps scoring area
-                        bro in my scoring area cant help
-                        pushing area must be empty 
-                    if a river
-
-                */
-                for (auto const& [dx, dy] : dirs) {
-                    int nx = x + dx, ny = y + dy;
-                    if (
-                        !is_inside_board(nx, ny) || 
-                        board[ny][nx].empty() 
-                    ) {
-                            continue;
-                        }
-
-                    if (piece_side == "stone") {
-                        int nx2 = x + 2*dx, ny2 = y + 2*dy;
-                        if (
-                            is_inside_board(nx2, ny2) && 
-                            board[ny2][nx2].empty() && 
-                            !(get_key(board[ny][nx], "owner")==current_opponent_side) && present_in_scoring(nx2, ny2, pid, score_cols) &&
-                            !(get_key(board[ny][nx], "owner")==current_opponent_side) && present_in_scoring(nx2, ny2, current_opponent_side, score_cols) &&
-                            !(get_key(board[ny][nx], "owner")==pid) && present_in_scoring(nx2, ny2, current_opponent_side, score_cols)
-                        ){
-                            moves.push_back({"push", {x, y}, {nx, ny}, {nx2, ny2}, ""});
-                        }
-                    } else {
-                        if (get_key(board[ny][nx], "side") == "stone") {
-                            string orientation = get_key(cell, "orientation");
-                            int push_dx = (orientation == "horizontal") ? 1 : 0, push_dy = (orientation == "vertical") ? 1 : 0;
-                            for (int dir = -1; dir <= 1; dir += 2) {
-                                int cur_px = nx + push_dx * dir, cur_py = ny + push_dy * dir;
-                                while(is_inside_board(cur_px, cur_py)) {
-                                    if ( (get_key(board[ny][nx], "owner")==current_opponent_side) && present_in_scoring(cur_px, cur_py, pid, score_cols)) break;
-                                    if ( (get_key(board[ny][nx], "owner")==current_opponent_side) && present_in_scoring(cur_px, cur_py, current_opponent_side, score_cols)) break;
-                                    if ( (get_key(board[ny][nx], "owner")==pid) && present_in_scoring(cur_px, cur_py, current_opponent_side, score_cols)) break;
-                                    if(board[cur_py][cur_px].empty()) moves.push_back({"push", {x, y}, {nx, ny}, {cur_px, cur_py}, ""});
-                                    else break;
-                                    cur_px += push_dx * dir; cur_py += push_dy * dir;
-                                }
-                            }
-                        }
-                    }
-                }
+                for_each_step_or_push(geo, board, p, scoring, x, y, rivers, ALL_CELLS, true, [&](PackedMove move) {
+                    moves.push_back(move);
+                });
 
-                if (piece_side == "stone") {
-                    moves.push_back({"flip", {x, y}, {x, y}, {}, "horizontal"});
-                    moves.push_back({"flip", {x, y}, {x, y}, {}, "vertical"});
+                if (piece_is_stone) {
+                    moves.push_back(pack_move(MOVE_FLIP, from, from, 0, ORIENT_HORIZONTAL));
+                    moves.push_back(pack_move(MOVE_FLIP, from, from, 0, ORIENT_VERTICAL));
                 } else {
-                    moves.push_back({"flip", {x, y}, {x, y}, {}, ""});
-                    moves.push_back({"rotate", {x, y}, {x, y}, {}, ""});
+                    moves.push_back(pack_move(MOVE_FLIP, from, from));
+                    moves.push_back(pack_move(MOVE_ROTATE, from, from));
                 }
             }
         }
@@ -318,11 +1147,11 @@ public:
     }
 
 
-    optional<Move> find_immediate_flip_in_scoring_area(const BoardState& board, const vector<int>& score_cols) {
+    optional<PackedMove> find_immediate_flip_in_scoring_area(const BoardState& board, const vector<int>& score_cols) {
         for (int y = 0; y < board_rows; ++y) {
             for (int x = 0; x < board_cols; ++x) {
-                if (!board[y][x].empty() && get_key(board[y][x], "owner") == this->side && get_key(board[y][x], "side") == "river" && present_in_scoring(x, y, this->side, score_cols)) {
-                    return Move{"flip", {x, y}, {x, y}, {}, ""};
+                if (board.owner(x, y) == side && board.is_river(x, y) && in_scoring_area(board.index(x, y), side, score_cols)) {
+                    return pack_move(MOVE_FLIP, board.index(x, y), board.index(x, y));
                 }
             }
         }
@@ -330,85 +1159,109 @@ public:
     }
 
 
-    BoardState try_move(const BoardState& board, const Move& move, const vector<int>& score_cols) {
-        auto move_applied_board = board;
-        if (move.from.size() < 2) return move_applied_board;
-        int from_x = move.from[0], from_y = move.from[1];
-        if (!is_inside_board(from_x, from_y) || move_applied_board[from_y][from_x].empty()) return move_applied_board;
-
-        string owner = get_key(move_applied_board[from_y][from_x], "owner");
-
-        if (move.action == "move") {
-            if (move.to.size() < 2) return move_applied_board;
-            int to_x = move.to[0], to_y = move.to[1];
-            if (!is_inside_board(to_x, to_y)) return move_applied_board;
-
-            move_applied_board[to_y][to_x] = move_applied_board[from_y][from_x];
-            move_applied_board[from_y][from_x].clear();
-
-            if (present_in_scoring(to_x, to_y, owner, score_cols)) {
-                move_applied_board[to_y][to_x]["side"] = "stone";
-                move_applied_board[to_y][to_x].erase("orientation");
+    // applies move to board in place. same rules as the old copy-on-apply
+    // try_move: a piece landing in its owner's scoring row turns stone side up
+    void make_move(BoardState& board, PackedMove move, const vector<int>& score_cols, UndoRecord& undo) {
+        undo.count = 0;
+        if (move == NO_MOVE) return;
+        int cols = board.cols;
+        int from = move_from(move);
+        int from_x = from % cols, from_y = from / cols;
+        if (!is_inside_board(from_x, from_y) || board.is_empty(from_x, from_y)) return;
+
+        auto save = [&](int i) {
+            undo.cells[undo.count] = static_cast<uint8_t>(i);
+            undo.codes[undo.count] = board.cell_at(i);
+            undo.count++;
+        };
+
+        int owner = board.owner_at(from);
+        uint32_t kind = move_kind(move);
+
+        if (kind == MOVE_STEP) {
+            int to = move_to(move);
+            int to_x = to % cols, to_y = to / cols;
+            if (!is_inside_board(to_x, to_y)) return;
+
+            save(from);
+            save(to);
+            board.set_cell_at(to, board.cell_at(from));
+            board.set_cell_at(from, CELL_EMPTY);
+
+            if (in_scoring_area(to, owner, score_cols)) {
+                board.make_stone(to_x, to_y);
             }
 
         } 
-        else if (move.action == "push") {
-            if (move.to.size() < 2 || move.pushed_to.size() < 2) return move_applied_board;
-            int to_x = move.to[0], to_y = move.to[1];
-            int p_x = move.pushed_to[0], p_y = move.pushed_to[1];
-            if (!is_inside_board(to_x, to_y) || !is_inside_board(p_x, p_y)) return move_applied_board;
-
-            move_applied_board[p_y][p_x] = move_applied_board[to_y][to_x];
-            string pushed_owner = get_key(move_applied_board[p_y][p_x], "owner");
-
-            if (present_in_scoring(p_x, p_y, pushed_owner, score_cols)) {
-                move_applied_board[p_y][p_x]["side"] = "stone";
-                move_applied_board[p_y][p_x].erase("orientation");
+        else if (kind == MOVE_PUSH) {
+            int to = move_to(move), pushed = move_pushed_to(move);
+            int to_x = to % cols, to_y = to / cols;
+            int p_x = pushed % cols, p_y = pushed / cols;
+            if (!is_inside_board(to_x, to_y) || !is_inside_board(p_x, p_y)) return;
+
+            save(from);
+            save(to);
+            save(pushed);
+            board.set_cell_at(pushed, board.cell_at(to));
+            int pushed_owner = board.owner_at(pushed);
+
+            if (pushed_owner >= 0 && in_scoring_area(pushed, pushed_owner, score_cols)) {
+                board.make_stone(p_x, p_y);
             }
 
-            move_applied_board[to_y][to_x] = move_applied_board[from_y][from_x];
+            board.set_cell_at(to, board.cell_at(from));
 
-            if (present_in_scoring(to_x, to_y, owner, score_cols)) {
-                move_applied_board[to_y][to_x]["side"] = "stone";
-                move_applied_board[to_y][to_x].erase("orientation");
+            if (in_scoring_area(to, owner, score_cols)) {
+                board.make_stone(to_x, to_y);
             }
 
-            move_applied_board[from_y][from_x].clear();
+            board.set_cell_at(from, CELL_EMPTY);
 
         } 
-        else if (move.action == "flip" || move.action == "rotate") {
-            if (move.action == "flip") {
-                auto& piece_to_flip = move_applied_board[from_y][from_x];
-                if (get_key(piece_to_flip, "side") == "stone") {
-                    piece_to_flip["side"] = "river";
-                    piece_to_flip["orientation"] = move.orientation;
+        else {
+            save(from);
+            uint8_t code = board.cell_at(from);
+            if (kind == MOVE_FLIP) {
+                if (!(code & CELL_RIVER)) {
+                    code |= CELL_RIVER;
+                    if (move_orientation(move) == ORIENT_VERTICAL) code |= CELL_VERTICAL;
                 } 
                 else {
-                    piece_to_flip["side"] = "stone";
-                    piece_to_flip.erase("orientation");
+                    code &= CELL_OWNER_MASK;
                 }
 
             } 
-            else if (move.action == "rotate") {
-                auto& piece_to_rotate = move_applied_board[from_y][from_x];
-                piece_to_rotate["orientation"] = (get_key(piece_to_rotate, "orientation") == "horizontal") ? "vertical" : "horizontal";
+            else {
+                code ^= CELL_VERTICAL;
             }
+            board.set_cell_at(from, code);
         }
-        
+    }
+
+    void unmake_move(BoardState& board, const UndoRecord& undo) {
+        for (int k = undo.count - 1; k >= 0; --k) {
+            board.set_cell_at(undo.cells[k], undo.codes[k]);
+        }
+    }
 
+    BoardState try_move(const BoardState& board, PackedMove move, const vector<int>& score_cols) {
+        auto move_applied_board = board;
+        UndoRecord undo;
+        make_move(move_applied_board, move, score_cols, undo);
         return move_applied_board;
     }
 
-    string check_if_won(const BoardState& board, const vector<int>& score_cols) {
-        if (count_pieces_in_score_area(board, "circle", score_cols) >= 4) {
+    // the winner, NO_PLAYER while the game goes on
+    Player check_if_won(const BoardState& board, const vector<int>& score_cols) {
+        if (count_pieces_in_score_area(board, CIRCLE, score_cols) >= 4) {
             // cout << "declare circle win" << endl;
-            return "circle";
+            return CIRCLE;
         }
-        if (count_pieces_in_score_area(board, "square", score_cols) >= 4) {
+        if (count_pieces_in_score_area(board, SQUARE, score_cols) >= 4) {
             // cout << "declare square win" << endl;
-            return "square";
+            return SQUARE;
         }
-        return "";
+        return NO_PLAYER;
     }
 
 
@@ -420,125 +1273,61 @@ public:
         return min_dist;
     }
 
-    bool is_valid_move(const Move& move, const BoardState& board, const vector<int>& score_cols) {
-        if (move.from.size() < 2 || move.to.size() < 2) return false;
+    bool is_valid_move(PackedMove move, const BoardState& board, const vector<int>& score_cols) {
+        if (move == NO_MOVE) return false;
 
-        int fx = move.from[0], fy = move.from[1];
-        int tx = move.to[0], ty = move.to[1];
+        int fx = move_from(move) % board.cols, fy = move_from(move) / board.cols;
+        int tx = move_to(move) % board.cols, ty = move_to(move) / board.cols;
 
         if (!is_inside_board(fx, fy) || !is_inside_board(tx, ty)) return false;
 
-        if (board[fy][fx].empty() || get_key(board[fy][fx], "owner") != side) return false;
+        if (board.owner(fx, fy) != side) return false;
 
-        auto sgn = [](int v) { return (v > 0) - (v < 0); };
-
-        if (move.action == "move") {
-            if (!board[ty][tx].empty()) return false;
+        if (move_kind(move) == MOVE_STEP) {
+            if (!board.is_empty(tx, ty)) return false;
 
             BoardState next = try_move(board, move, score_cols);
-            return !next[ty][tx].empty() && get_key(next[ty][tx], "owner") == side;
-        }
-
-        if (move.action == "push") {
-            // cout << "push" << endl;
-            if (move.pushed_to.size() < 2) return false;
-            int px = move.pushed_to[0], py = move.pushed_to[1];
-
-            if (!is_inside_board(px, py)) return false;
-
-            string type_of_piece = get_key(board[fy][fx], "type");  
-
-            if (type_of_piece == "stone") {
-                int dx = tx - fx, dy = ty - fy;
-                if (abs(dx) + abs(dy) != 1) return false;
-
-                if (board[ty][tx].empty()) return false;
-
-                if (!is_inside_board(px, py)) return false;
-                if (!board[py][px].empty()) return false;
-
-                BoardState next = try_move(board, move, score_cols);
-
-                if (next[ty][tx].empty() || get_key(next[ty][tx], "owner") != side) return false;
-                if (next[py][px].empty()) return false;
-
-                return true;
-            }
-
-
-            if (type_of_piece == "river") {
-
-                if (board[ty][tx].empty() || get_key(board[ty][tx], "type") != "stone")
-                    return false;
-
-                int dx = (px - tx == 0) ? 0 : (px - tx) / abs(px - tx);
-                int dy = (py - ty == 0) ? 0 : (py - ty) / abs(py - ty);
-
-
-                if (dx != 0 && dy != 0) return false;
-
-
-                int steps = max(abs(px - tx), abs(py - ty));
-                if (steps < 1) return false;
-                for (int i = 1; i <= steps; i++) {
-                    int cx = tx + dx * i;
-                    int cy = ty + dy * i;
-                    if (!is_inside_board(cx, cy)) return false;
-                    if (i < steps && !board[cy][cx].empty()) return false; 
-                }
-
-                BoardState next = try_move(board, move, score_cols);
-
-                if (next[ty][tx].empty() || get_key(next[ty][tx], "type") != "stone") return false;
-                if (get_key(next[ty][tx], "owner") != side) return false;
-
-
-                if (next[py][px].empty() || get_key(next[py][px], "type") != "stone") return false;
-
-
-
-                return true;
-            }
-
-            return false;
+            return next.owner(tx, ty) == side;
         }
 
-
+        // pushes were looked up through a "type" key that the python board
+        // never carries, so they have always been rejected here
         return false;
     };
 
-    optional<Move> find_direct_entry_path(const BoardState& board, const vector<int>& score_cols) {
+    optional<PackedMove> find_direct_entry_path(const BoardState& board, const vector<int>& score_cols) {
         auto moves = get_all_moves(board, side, score_cols);
         if (moves.empty()) return nullopt;
 
-        int scoring_row = (side == "circle") ? 2 : board_rows - 3;
+        int scoring_row = (side == CIRCLE) ? 2 : board_rows - 3;
 
         vector<int> gap_cols;
         for (int sx : score_cols) {
-            if (is_inside_board(sx, scoring_row) && board[scoring_row][sx].empty()) {
+            if (is_inside_board(sx, scoring_row) && board.is_empty(sx, scoring_row)) {
                 gap_cols.push_back(sx);
             }
         }
 
-        for (const auto& move : moves) {
-            if ((move.action != "move" && move.action != "push") ||
-                present_in_scoring(move.from[0], move.from[1], side, score_cols)) continue;
+        int cols = board.cols;
+        for (PackedMove move : moves) {
+            if (move_kind(move) > MOVE_PUSH ||
+                present_in_scoring(move_from(move) % cols, move_from(move) / cols, side, score_cols)) continue;
 
             if (!is_valid_move(move, board, score_cols)) continue;
 
-            int tx = move.to[0], ty = move.to[1];
+            int tx = move_to(move) % cols, ty = move_to(move) / cols;
             if (present_in_scoring(tx, ty, side, score_cols)) return move;
         }
 
         if (!gap_cols.empty()) {
-            for (const auto& move : moves) {
-                if ((move.action != "move" && move.action != "push") ||
-                    present_in_scoring(move.from[0], move.from[1], side, score_cols)) continue;
+            for (PackedMove move : moves) {
+                if (move_kind(move) > MOVE_PUSH ||
+                    present_in_scoring(move_from(move) % cols, move_from(move) / cols, side, score_cols)) continue;
 
                 if (!is_valid_move(move, board, score_cols)) continue;
 
-                int old_dist = dist_to_closest_gap(move.from[0], move.from[1], gap_cols, scoring_row);
-                int new_dist = dist_to_closest_gap(move.to[0], move.to[1], gap_cols, scoring_row);
+                int old_dist = dist_to_closest_gap(move_from(move) % cols, move_from(move) / cols, gap_cols, scoring_row);
+                int new_dist = dist_to_closest_gap(move_to(move) % cols, move_to(move) / cols, gap_cols, scoring_row);
                 if (new_dist < old_dist) return move;
             }
         }
@@ -546,24 +1335,112 @@ public:
         return nullopt;
     }
 
-    double evaluate_position(const BoardState& board, const string& pid, const vector<int>& score_cols) {
+    double evaluate_position(const BoardState& board, Player pid, const vector<int>& score_cols) {
         int my_stones = count_pieces_in_score_area(board, pid, score_cols);
-        int opp_stones = count_pieces_in_score_area(board, (pid == "circle") ? "square" : "circle", score_cols);
+        int opp_stones = count_pieces_in_score_area(board, opponent_of(pid), score_cols);
         int my_near = count_pieces_near_score_area(board, pid, score_cols);
-        int opp_near = count_pieces_near_score_area(board, (pid == "circle") ? "square" : "circle", score_cols);
+        int opp_near = count_pieces_near_score_area(board, opponent_of(pid), score_cols);
         double score = (my_stones * 10.0 + my_near * 2.0) - (opp_stones * 10.0 + opp_near * 2.0);
         return 0.5 + (score / 100.0);
     }
 
 
-    int count_pieces_in_score_area(const BoardState& board, const string& pid, const vector<int>& score_cols) {
+    // copy of board with the agent's scoring masks attached, so every move
+    // applied to it keeps the scoring counters. also adopts the board's
+    // geometry, and drops the tree when the masks have to change
+    BoardState prepare_board(const BoardState& board, const vector<int>& score_cols) {
+        board_rows = board.rows;
+        board_cols = board.cols;
+        if (masks_rows != board_rows || masks_cols != board_cols || masks_score_cols != score_cols) {
+            stop_pondering();
+            tree.clear();
+            masks_ready = false;
+            scoring_cells(score_cols, score_masks.score);
+            for (int p = 0; p < 2; ++p) {
+                score_masks.near[p] = Bitboard();
+                int row = (p == 0) ? 3 : board_rows - 4;
+                for (int sx : score_cols) {
+                    if (is_inside_board(sx, row)) score_masks.near[p].set(row * board_cols + sx);
+                }
+                for (int d = 0; d <= MAX_SCORE_DIST; ++d) score_masks.closer[p][d] = Bitboard();
+                for (int y = 0; y < board_rows; ++y) {
+                    for (int x = 0; x < board_cols; ++x) {
+                        int dist = min(get_closest_score_dist(x, y, Player(p), score_cols, board_rows), MAX_SCORE_DIST);
+                        score_masks.dist[p][y * board_cols + x] = dist;
+                        for (int d = dist + 1; d <= MAX_SCORE_DIST; ++d) score_masks.closer[p][d].set(y * board_cols + x);
+                    }
+                }
+            }
+            build_step_masks(score_masks);
+            pick_geometry(board_rows, board_cols);
+            masks_rows = board_rows;
+            masks_cols = board_cols;
+            masks_score_cols = score_cols;
+            masks_ready = true;
+        }
+        BoardState prepared = board;
+        if (prepared.masks != &score_masks) prepared.attach(&score_masks);
+        return prepared;
+    }
+
+    // sizes with their own compiled geometry: the engine's only board,
+    // DEFAULT_ROWS x DEFAULT_COLS = 13 x 12. any other size runs AnyGeometry
+    void pick_geometry(int rows, int cols) {
+        if (rows == 13 && cols == 12) use_geometry<FixedGeometry<13, 12>>();
+        else use_geometry<AnyGeometry>();
+    }
+
+    template <typename Geo>
+    void use_geometry() {
+        move_gen_for_size = &StudentAgent::get_all_moves_in<Geo>;
+        playouts_for_size = &StudentAgent::simulate_playouts_in<Geo>;
+    }
+
+    // held, step_* and neighbour tables of ScoreMasks, for the current geometry
+    void build_step_masks(ScoreMasks& masks) {
+        static const pair<int, int> dirs[4] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
+        for (int p = 0; p < 2; ++p) {
+            masks.held[p] = Bitboard();
+            int fixed_row_a = (p == 0) ? 10 : 2;
+            int fixed_row_b = (p == 0) ? 11 : 1;
+            int conditional_row = (p == 0) ? 9 : 3;
+            for (int y = 0; y < board_rows; ++y) {
+                for (int x = 0; x < board_cols; ++x) {
+                    if (((x == 3 || x == 8) && (y == fixed_row_a || y == fixed_row_b)) || (x >= 4 && x <= 7 && y == conditional_row)) {
+                        masks.held[p].set(y * board_cols + x);
+                    }
+                }
+            }
+        }
+        for (int d = 0; d < 4; ++d) {
+            auto [dx, dy] = dirs[d];
+            masks.step_delta[d] = dy * board_cols + dx;
+            masks.step_source[d] = Bitboard();
+            masks.step_allowed[0][d] = masks.step_allowed[1][d] = Bitboard();
+            for (int y = 0; y < board_rows; ++y) {
+                for (int x = 0; x < board_cols; ++x) {
+                    masks.neighbour[y * board_cols + x][d] = -1;
+                    if (!is_inside_board(x + dx, y + dy)) continue;
+                    int from = y * board_cols + x, to = from + masks.step_delta[d];
+                    masks.neighbour[from][d] = to;
+                    masks.step_source[d].set(from);
+                    for (int p = 0; p < 2; ++p) {
+                        if (!masks.score[1 - p].test(to) && masks.dist[p][to] < masks.dist[p][from]) masks.step_allowed[p][d].set(to);
+                    }
+                }
+            }
+        }
+    }
+
+    // o(1) on boards from prepare_board, a scan otherwise
+    int count_pieces_in_score_area(const BoardState& board, Player pid, const vector<int>& score_cols) {
+        if (board.masks == &score_masks) return board.score_count[pid];
         int count = 0;
+        const Bitboard& own_stones = board.stones[pid];
         for (int y = 0; y < board_rows; ++y) {
             for (int x = 0; x < board_cols; ++x) {
-                if (!board[y][x].empty() && 
-                    get_key(board[y][x], "owner") == pid && 
-                    get_key(board[y][x], "side") == "stone" &&
-                    present_in_scoring(x, y, pid, score_cols)) {
+                if (own_stones.test(board.index(x, y)) &&
+                    in_scoring_area(board.index(x, y), pid, score_cols)) {
                     count++;
                 }
             }
@@ -571,12 +1448,12 @@ public:
         return count;
     }
 
-    int count_pieces_near_score_area(const BoardState& board, const string& pid, const vector<int>& score_cols) {
+    int count_pieces_near_score_area(const BoardState& board, Player pid, const vector<int>& score_cols) {
+        if (board.masks == &score_masks) return board.near_count[pid];
         int count = 0;
-        int target_y = (pid == "circle") ? 3 : board_rows - 4;
+        int target_y = (pid == CIRCLE) ? 3 : board_rows - 4;
         for (int x : score_cols) {
-            if (is_inside_board(x, target_y) && !board[target_y][x].empty() && 
-                get_key(board[target_y][x], "owner") == pid) {
+            if (is_inside_board(x, target_y) && board.owner(x, target_y) == pid) {
                 count++;
             }
         }
@@ -584,15 +1461,31 @@ public:
     }
 
 
-    Node* mcts_select_init_node(Node* root) {
+    // adds a node to the selection path. in tree-parallel mode each node on
+    // the path carries virtual_loss extra zero-win visits until backprop, which
+    // steers the other threads towards different lines
+    void enter_node(vector<Node*>& path, Node* node, int virtual_loss) {
+        path.push_back(node);
+        if (virtual_loss) node->playouts += virtual_loss;
+    }
+
+    // path receives the nodes walked from root to the returned node; with
+    // shared nodes there is no single parent to climb back up through
+    Node* mcts_select_init_node(SearchTree& tree, Node* root, vector<Node*>& path, int virtual_loss) {
         // cout << "in select node " << endl;
         Node* current = root;
+        path.clear();
+        enter_node(path, root, virtual_loss);
 
         while (current->is_fully_expanded && !current->is_terminal) {
             Node* best_child = nullptr;
             double best_score = -numeric_limits<double>::infinity();
 
-            for (const auto& child : current->children) {
+            lock_guard<mutex> lock(current->mtx);
+            for (const auto& edge : current->children) {
+                Node* child = &tree.arena[edge.child];
+                // a transposition can lead back onto the path, never walk a cycle
+                if (find(path.begin(), path.end(), child) != path.end()) continue;
                 double uct_score;
 
                 double approx_uct_score, exact_uct_score;
@@ -603,9 +1496,9 @@ public:
                 
                 else {
 
-                    double parent_visits = static_cast<double>(max(1, current->playouts));
+                    double parent_visits = static_cast<double>(max(1, current->playouts.load()));
                     double exploitation = static_cast<double>(child->wins) / static_cast<double>(child->playouts);
-                    double exploration = UCT_C * sqrt(log(parent_visits) / static_cast<double>(child->playouts));
+                    double exploration = uct_c * sqrt(log(parent_visits) / static_cast<double>(child->playouts));
                     uct_score = exploitation + exploration;
                 }
 
@@ -615,12 +1508,13 @@ public:
 
                 if (uct_score > best_score) {
                     best_score = uct_score;
-                    best_child = child.get();
+                    best_child = child;
                 }
             }
 
             if (!best_child) break; // safety
             current = best_child;
+            enter_node(path, current, virtual_loss);
             // cout << current->children.size() << " children" << endl;
         }
         // cout << "exit sekect bni" << endl;
@@ -628,62 +1522,102 @@ public:
     }
 
 
-    Node* mcts_expand_node(Node* node, const vector<int>& score_cols) {
-        if (node->untried_moves.empty()) {
-            node->is_fully_expanded = true;
-            return node;
+    Node* mcts_expand_node(SearchTree& tree, SearchWorker& worker, Node* node, const vector<int>& score_cols) {
+        PackedMove move;
+        {
+            lock_guard<mutex> lock(node->mtx);
+            if (node->untried_moves.empty()) {
+                node->is_fully_expanded = true;
+                return node;
+            }
+            // out of nodes: the caller plays out from this node instead. only a
+            // shortcut, the cap itself is enforced where nodes are allocated
+            if (tree.arena.size() >= node_cap) return node;
+            move = node->untried_moves.back();
+            node->untried_moves.pop_back();
+            if (node->untried_moves.empty()) node->is_fully_expanded = true;
         }
-        Move move = node->untried_moves.back();
-        node->untried_moves.pop_back();
-        if (node->untried_moves.empty()) node->is_fully_expanded = true;
-        
+
         BoardState new_state = try_move(node->state, move, score_cols);
-        auto mcts_child = make_unique<Node>();
-        mcts_child->state = new_state;
-        mcts_child->parent = node;
-        mcts_child->move = move;
-        if (node->pid== "circle") {
-            mcts_child->pid = "square";
+        Player child_pid = opponent_of(node->pid);
+        uint64_t key = position_key(new_state, child_pid);
+
+        // done before taking the table lock so threads generate moves in parallel
+        Player winner = check_if_won(new_state, score_cols);
+        vector<PackedMove> child_moves;
+        if (winner == NO_PLAYER) {
+            auto mark = chrono::steady_clock::now();
+            worker.move_gen_rivers.valid = false;
+            child_moves = get_all_moves(new_state, child_pid, score_cols, worker.move_gen_rivers);
+            order_for_expansion(child_moves, new_state, child_pid, score_cols, worker.rng);
+            worker.stats.move_gen_time += lap(mark);
         }
-        else {
-            mcts_child->pid = "circle";
-        }
-        
-        string winner = check_if_won(new_state, score_cols);
-        if (!winner.empty()) {
-            mcts_child->is_terminal = true;
-            mcts_child->terminal_result = winner;
-        } 
-        
-        else {
-            if (!winner.empty()) {
-                mcts_child->is_terminal = true;
-                mcts_child->terminal_result = winner;
-            } 
-            mcts_child->untried_moves = get_all_moves(new_state, mcts_child->pid, score_cols);
-            if (mcts_child->untried_moves.empty()) {
-                mcts_child->is_terminal = true;
+
+        NodeIndex child_index;
+        Node* mcts_child = nullptr;
+        {
+            lock_guard<mutex> lock(tree.table_mutex);
+            worker.tt_lookups++;
+            auto found = tree.node_table.find(key);
+            if (found != tree.node_table.end()) {
+                worker.tt_hits++;
+                child_index = found->second;
+                mcts_child = &tree.arena[child_index];
+            }
+            // the cap is checked under the same lock as the alloc, so threads
+            // expanding different nodes cannot all pass it and overshoot
+            else if (tree.arena.size() < node_cap) {
+                child_index = tree.arena.alloc();
+                mcts_child = &tree.arena[child_index];
+                mcts_child->state = new_state;
+                mcts_child->key = key;
+                mcts_child->pid = child_pid;
+                
+                if (winner != NO_PLAYER) {
+                    mcts_child->is_terminal = true;
+                    mcts_child->terminal_result = winner;
+                } 
+                else {
+                    mcts_child->untried_moves = std::move(child_moves);
+                    if (mcts_child->untried_moves.empty()) {
+                        mcts_child->is_terminal = true;
+                    }
+                }
+                tree.node_table.emplace(key, child_index);
             }
         }
-        
-        Node* child_ptr = mcts_child.get();
-        node->children.push_back(std::move(mcts_child));
-        return child_ptr;
+
+        lock_guard<mutex> lock(node->mtx);
+        if (!mcts_child) {
+            // the arena filled up meanwhile: the move stays untried
+            node->untried_moves.push_back(move);
+            node->is_fully_expanded = false;
+            return node;
+        }
+        node->children.push_back({move, child_index});
+        return mcts_child;
     }
 
 
-    void backpropagate(Node* node, double result) {
-        Node* current_node = node;
-        while (current_node != nullptr) {
-            current_node->playouts++;
-            if (current_node->parent != nullptr) {
-                if (current_node->parent->pid != this->side) current_node->wins += (1.0 - result);
-                else current_node->wins += result;
+    // wins are kept from the point of view of the player who moved into the node.
+    // results are never negative, so adding the truncated value matches the old
+    // int += double update
+    void backpropagate(const vector<Node*>& path, double result, int virtual_loss) {
+        for (size_t k = 0; k < path.size(); ++k) {
+            Node* current_node = path[k];
+            current_node->playouts += 1 - virtual_loss;
+            if (k > 0) {
+                if (current_node->pid == this->side) current_node->wins += (int)(1.0 - result);
+                else current_node->wins += (int)result;
             }
-            current_node = current_node->parent;
         }
     }
 
+    void revert_virtual_loss(const vector<Node*>& path, int virtual_loss) {
+        if (!virtual_loss) return;
+        for (Node* node : path) node->playouts -= virtual_loss;
+    }
+
     int get_closest_gap_dist(int px, int py, int scoring_row_for_current_player, const vector<int>& gap_cols) {
         int min_dist = numeric_limits<int>::max();
         for (int gx : gap_cols) {
@@ -693,46 +1627,47 @@ public:
     };
 
 
-    int get_closest_score_dist(int px, int py, const string& pid, const vector<int>& score_cols, int board_rows) {
+    int get_closest_score_dist(int px, int py, Player pid, const vector<int>& score_cols, int board_rows) {
         int min_dist = numeric_limits<int>::max();
-        int scoring_row_for_current_player = (pid == "circle") ? 2 : board_rows - 3;
+        int scoring_row_for_current_player = (pid == CIRCLE) ? 2 : board_rows - 3;
         for (int sx : score_cols) {
             min_dist = min(min_dist, abs(px - sx) + abs(py - scoring_row_for_current_player));
         }
         return min_dist;
     };
 
-    Move find_playout_move( const vector<Move>& moves, const BoardState& board,  const string& pid, const vector<int>& score_cols) {
-        if (moves.empty()) return {};
+    PackedMove find_playout_move( const vector<PackedMove>& moves, const BoardState& board,  Player pid, const vector<int>& score_cols, mt19937& rng) {
+        if (moves.empty()) return NO_MOVE;
 
-        vector<Move> scoring_moves, distance_reducing_moves, gap_moves;
+        vector<PackedMove> scoring_moves, distance_reducing_moves, gap_moves;
 
 
-        int scoring_row_for_current_player = (pid == "circle") ? 2 : board_rows - 3;
+        int scoring_row_for_current_player = (pid == CIRCLE) ? 2 : board_rows - 3;
         vector<int> gap_cols;
         for (int sx : score_cols) {
-            if (is_inside_board(sx, scoring_row_for_current_player) && board[scoring_row_for_current_player][sx].empty()) {
+            if (is_inside_board(sx, scoring_row_for_current_player) && board.is_empty(sx, scoring_row_for_current_player)) {
                 gap_cols.push_back(sx);
             }
         }
 
         
 
-        for (const auto& move : moves) {
-            if (move.action == "move" || move.action == "push") {
-                if (move.from.empty() || move.to.empty()) continue;
-                vector<int> start = move.from;
-                vector<int> target = move.to;
+        int cols = board.cols;
+        int p = pid;
+        for (PackedMove move : moves) {
+            if (move_kind(move) == MOVE_STEP || move_kind(move) == MOVE_PUSH) {
+                int start[2] = {move_from(move) % cols, move_from(move) / cols};
+                int target[2] = {move_to(move) % cols, move_to(move) / cols};
 
 
-                if (present_in_scoring(target[0], target[1], pid, score_cols)) {
+                if (in_scoring_area(move_to(move), p, score_cols)) {
                     scoring_moves.push_back(move);
                     continue;
                 }
 
 
-                int old_dist = get_closest_score_dist(start[0], start[1], pid, score_cols, board_rows);
-                int new_dist = get_closest_score_dist(target[0], target[1], pid, score_cols, board_rows);
+                int old_dist = closest_score_dist_at(move_from(move), p, score_cols);
+                int new_dist = closest_score_dist_at(move_to(move), p, score_cols);
                 if (new_dist < old_dist) {
                     distance_reducing_moves.push_back(move);
                     continue;
@@ -749,52 +1684,206 @@ public:
             }
         }
 
-        if (!scoring_moves.empty()) return scoring_moves[gen() % scoring_moves.size()];
-        if (!distance_reducing_moves.empty()) return distance_reducing_moves[gen() % distance_reducing_moves.size()];
-        if (!gap_moves.empty()) return gap_moves[gen() % gap_moves.size()];
+        if (!scoring_moves.empty()) return scoring_moves[rng() % scoring_moves.size()];
+        if (!distance_reducing_moves.empty()) return distance_reducing_moves[rng() % distance_reducing_moves.size()];
+        if (!gap_moves.empty()) return gap_moves[rng() % gap_moves.size()];
 
 
-        return moves[gen() % moves.size()];
+        return moves[rng() % moves.size()];
     }
 
+    // find_playout_move without building the full move list. the stages are
+    // its buckets in order: scoring moves, distance-reducing moves, moves
+    // towards an empty scoring cell, then any move. a stage only generates
+    // moves landing on its target cells and the first non-empty one is
+    // sampled uniformly, so the policy is the same; flips, rotations and
+    // moves away from the scoring area are only generated when nothing
+    // better exists. steps[d] are the step kernel's targets for board and
+    // pid. board must come from prepare_board
+    template <typename Geo>
+    PackedMove staged_playout_move(SearchWorker& worker, const BoardState& board, Player pid, const vector<int>& score_cols, RiverNetwork& rivers, const Bitboard* steps) {
+        Geo geo(board);
+        int p = pid;
+        int opp = 1 - p;
+        refresh_rivers(board, score_cols, rivers);
+
+        vector<PackedMove>& stage = worker.playout_moves;
+        vector<PackedMove>& reducing = worker.reducing_moves;
+        stage.clear();
+        reducing.clear();
+        auto pick = [&]() { return stage[worker.rng() % stage.size()]; };
+        auto sort_move = [&](PackedMove move) {
+            if (score_masks.score[p].test(move_to(move))) stage.push_back(move);
+            else reducing.push_back(move);
+        };
+
+        // scoring and distance-reducing moves in one pass: a piece outside
+        // the scoring area is at distance >= 1, so the cells closer than it
+        // include the scoring cells
+        for (int d = 0; d < 4; ++d) {
+            int delta = score_masks.step_delta[d];
+            steps[d].for_each([&](int to) { sort_move(pack_move(MOVE_STEP, to - delta, to)); });
+        }
+        Bitboard occupied = board.stones[0];
+        occupied |= board.stones[1];
+        occupied |= board.rivers[0];
+        occupied |= board.rivers[1];
+        Bitboard outside, in_score;
+        for (int k = 0; k < BB_WORDS; ++k) {
+            uint64_t movable = (board.stones[p].w[k] | board.rivers[p].w[k]) & ~score_masks.held[p].w[k];
+            outside.w[k] = movable & ~score_masks.score[p].w[k];
+            in_score.w[k] = board.stones[p].w[k] & score_masks.score[p].w[k] & ~score_masks.held[p].w[k];
+        }
+        outside.for_each([&](int from) {
+            // flows and pushes need a river or a piece next to the mover
+            int x = from % geo.cols, y = from / geo.cols;
+            const int16_t* next = score_masks.neighbour[from];
+            bool crowded = false;
+            for (int d = 0; d < 4 && !crowded; ++d) {
+                crowded = next[d] >= 0 && occupied.test(next[d]);
+            }
+            if (!crowded) return;
+            const Bitboard& filter = score_masks.closer[p][score_masks.dist[p][from]];
+            for_each_step_or_push(geo, board, p, score_masks.score, x, y, rivers, filter, false, sort_move);
+        });
+        // stones already scoring may only slide along the scoring area
+        in_score.for_each([&](int from) {
+            for (int d : {3, 2}) {
+                int to = score_masks.neighbour[from][d];
+                if (to >= 0 && score_masks.score[p].test(to) && !score_masks.score[opp].test(to) && board.is_empty_at(to)) {
+                    stage.push_back(pack_move(MOVE_STEP, from, to));
+                }
+            }
+        });
+        if (!stage.empty()) return pick();
+        stage.swap(reducing);
+        if (!stage.empty()) return pick();
 
-    double simulate_playout(Node* node, const vector<int>& score_cols) {
-        if (node->is_terminal) {
-            if (node->terminal_result == this->side) return 1.0;
-            if (node->terminal_result.empty()) return 0.5;
-            return 0.0;
+        int scoring_row_for_current_player = geo.score_row(p);
+        vector<int> gap_cols;
+        for (int sx : score_cols) {
+            if (geo.inside(sx, scoring_row_for_current_player) && board.is_empty_at(geo.index(sx, scoring_row_for_current_player))) {
+                gap_cols.push_back(sx);
+            }
+        }
+        if (!gap_cols.empty()) {
+            outside.for_each([&](int from) {
+                int x = from % geo.cols, y = from / geo.cols;
+                int old_gap_dist = get_closest_gap_dist(x, y, scoring_row_for_current_player, gap_cols);
+                for_each_step_or_push(geo, board, p, score_masks.score, x, y, rivers, ALL_CELLS, true, [&](PackedMove move) {
+                    int to = move_to(move);
+                    if (get_closest_gap_dist(to % geo.cols, to / geo.cols, scoring_row_for_current_player, gap_cols) < old_gap_dist) {
+                        stage.push_back(move);
+                    }
+                });
+            });
+            if (!stage.empty()) return pick();
         }
-        int limit_at = 30;
-        
-        BoardState current_state = node->state;
-        string current_player = node->pid;
-        
-        while (limit_at > 0) {
 
-            limit_at -= 1;
-            string winner = check_if_won(current_state, score_cols);
+        stage = get_all_moves_in<Geo>(board, pid, score_cols, rivers);
+        if (stage.empty()) return NO_MOVE;
+        return pick();
+    }
 
 
-            if (!winner.empty()) return (winner == this->side) ? 1.0 : 0.0;
-            
-            
-            auto moves = get_all_moves(current_state, current_player, score_cols);
-            if (moves.empty()) return 0.5;
-            Move move_to_play = find_playout_move(moves, current_state, current_player, score_cols);
-            current_state = try_move(current_state, move_to_play, score_cols);
-            if (current_player == "circle") {
-                current_player = "square";
+    double simulate_playout(SearchWorker& worker, Node* node, const vector<int>& score_cols) {
+        double result;
+        simulate_playouts(worker, &node, 1, score_cols, &result);
+        return result;
+    }
+
+    // playouts from n nodes advanced together, one ply of every unfinished
+    // playout per round, so the step kernel sees all their boards at once.
+    // each playout follows the same rules as a lone one
+    void simulate_playouts(SearchWorker& worker, Node* const* nodes, int n, const vector<int>& score_cols, double* results) {
+        (this->*playouts_for_size)(worker, nodes, n, score_cols, results);
+    }
+
+    template <typename Geo>
+    void simulate_playouts_in(SearchWorker& worker, Node* const* nodes, int n, const vector<int>& score_cols, double* results) {
+        if ((int)worker.lanes.size() < n) worker.lanes.resize(n);
+        worker.lane_players.resize(n);
+        worker.lane_pieces.resize(n);
+        worker.lane_occupied.resize(n);
+        worker.lane_steps.resize(4 * n);
+
+        int active = 0;
+        for (int i = 0; i < n; ++i) {
+            PlayoutLane& lane = worker.lanes[i];
+            Node* node = nodes[i];
+            lane.done = node->is_terminal;
+            if (node->is_terminal) {
+                if (node->terminal_result == this->side) lane.result = 1.0;
+                else if (node->terminal_result == NO_PLAYER) lane.result = 0.5;
+                else lane.result = 0.0;
+                continue;
             }
-            else {
-                current_player = "circle";
+            lane.state = node->state;
+            lane.player = node->pid;
+            lane.rivers.valid = false;
+            active++;
+        }
+        worker.stats.playouts += active;
+
+        UndoRecord undo;
+        for (int limit_at = 30; limit_at > 0 && active > 0; --limit_at) {
+            // lanes still running, packed to the front of the kernel inputs
+            int m = 0;
+            for (int i = 0; i < n; ++i) {
+                PlayoutLane& lane = worker.lanes[i];
+                if (lane.done) continue;
+                Player winner = check_if_won(lane.state, score_cols);
+                if (winner != NO_PLAYER) {
+                    lane.result = (winner == this->side) ? 1.0 : 0.0;
+                    lane.done = true;
+                    active--;
+                    continue;
+                }
+                int p = lane.player;
+                const BoardState& b = lane.state;
+                worker.lane_players[m] = p;
+                for (int k = 0; k < BB_WORDS; ++k) {
+                    uint64_t own = b.stones[p].w[k] | b.rivers[p].w[k];
+                    worker.lane_pieces[m].w[k] = own & ~score_masks.held[p].w[k] & ~score_masks.score[p].w[k];
+                    worker.lane_occupied[m].w[k] = b.stones[0].w[k] | b.stones[1].w[k] | b.rivers[0].w[k] | b.rivers[1].w[k];
+                }
+                m++;
+            }
+            // move generation is timed on one round in 8 and scaled up; a
+            // clock read around every ply slows playouts down measurably
+            bool timed = (worker.rounds++ & 7) == 0;
+            auto mark = timed ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+            step_targets(score_masks, worker.lane_players.data(), worker.lane_pieces.data(), worker.lane_occupied.data(), m, worker.lane_steps.data());
+
+            int slot = 0;
+            for (int i = 0; i < n; ++i) {
+                PlayoutLane& lane = worker.lanes[i];
+                if (lane.done) continue;
+                PackedMove move_to_play = staged_playout_move<Geo>(worker, lane.state, lane.player, score_cols, lane.rivers, &worker.lane_steps[4 * slot++]);
+                if (timed) worker.stats.move_gen_time += 8 * lap(mark);
+                if (move_to_play == NO_MOVE) {
+                    lane.result = 0.5;
+                    lane.done = true;
+                    active--;
+                    continue;
+                }
+                make_move(lane.state, move_to_play, score_cols, undo);
+                lane.rivers.note_move(lane.state, undo);
+                lane.player = opponent_of(lane.player);
+                worker.stats.playout_plies++;
+                if (timed) mark = chrono::steady_clock::now();
             }
         }
-        return evaluate_position(current_state, this->side, score_cols);
+
+        for (int i = 0; i < n; ++i) {
+            PlayoutLane& lane = worker.lanes[i];
+            results[i] = lane.done ? lane.result : evaluate_position(lane.state, this->side, score_cols);
+        }
     }
 
 
     Move get_opening_move() {
-        if (side == "circle") {
+        if (side == CIRCLE) {
             if (turn_count == 1) return {"push", {3, 8}, {3, 9}, {3,10}, ""}; 
             if (turn_count == 2) return {"push", {3, 9}, {3, 10}, {3,11}, ""};
             if (turn_count == 3) return {"push", {8, 8}, {8, 9}, {8,10}, ""};
@@ -826,11 +1915,15 @@ public:
 
 
 
-    optional<Move> find_immediate_win(const BoardState& board, const vector<int>& score_cols) {
+    optional<PackedMove> find_immediate_win(const BoardState& board, const vector<int>& score_cols) {
         auto moves = get_all_moves(board, side, score_cols);
-        for (const auto& move : moves) {
-            BoardState next_state = try_move(board, move, score_cols);
-            if (check_if_won(next_state, score_cols) == side) {
+        BoardState scratch = board;
+        UndoRecord undo;
+        for (PackedMove move : moves) {
+            make_move(scratch, move, score_cols, undo);
+            bool won = check_if_won(scratch, score_cols) == side;
+            unmake_move(scratch, undo);
+            if (won) {
                 return move;
             }
         }
@@ -838,18 +1931,28 @@ public:
     }
 
 
-    optional<Move> block_opponent_win(const BoardState& board, const vector<int>& score_cols) {
+    // cell a move or push ends on, -1 for flips and rotates
+    int landing_square(PackedMove move) {
+        if (move_kind(move) == MOVE_STEP) return move_to(move);
+        if (move_kind(move) == MOVE_PUSH) return move_pushed_to(move);
+        return -1;
+    }
+
+    optional<PackedMove> block_opponent_win(const BoardState& board, const vector<int>& score_cols) {
         auto opponent_moves = get_all_moves(board, opponent_side, score_cols);
-        for (const auto& opp_move : opponent_moves) {
-            BoardState next_state = try_move(board, opp_move, score_cols);
-            if (check_if_won(next_state, score_cols) == opponent_side) {
-                vector<int> target_square = opp_move.action == "move" ? opp_move.to : opp_move.pushed_to;
-                if (target_square.empty()) continue;
+        BoardState scratch = board;
+        UndoRecord undo;
+        for (PackedMove opp_move : opponent_moves) {
+            make_move(scratch, opp_move, score_cols, undo);
+            bool opponent_wins = check_if_won(scratch, score_cols) == opponent_side;
+            unmake_move(scratch, undo);
+            if (opponent_wins) {
+                int target_square = landing_square(opp_move);
+                if (target_square < 0) continue;
 
                 auto my_moves = get_all_moves(board, side, score_cols);
-                for (const auto& my_move : my_moves) {
-                    vector<int> my_target = my_move.action == "move" ? my_move.to : my_move.pushed_to;
-                    if (my_target == target_square) {
+                for (PackedMove my_move : my_moves) {
+                    if (landing_square(my_move) == target_square) {
                         return my_move;
                     }
                 }
@@ -859,84 +1962,352 @@ public:
     }
 
 
-    bool is_equal_move(const Move &a, const Move &b){
-        return a.action == b.action && a.orientation == b.orientation && a.from == b.from && a.to == b.to && a.pushed_to == b.pushed_to;
+    bool is_equal_move(PackedMove a, PackedMove b){
+        return a == b;
     };
 
-    Move find_mcts_move(const BoardState& board, const vector<int>& score_cols) {
-        auto root_moves = get_all_moves(board, this->side, score_cols);
-        // cout << root_moves.size() << " possible moves" << endl;
-        if (root_moves.empty()) return {};
-        
-        auto root = make_unique<Node>();
+    Node* make_root(SearchTree& tree, const BoardState& board, Player pid, const vector<PackedMove>& root_moves, const vector<int>& score_cols, mt19937& rng) {
+        NodeIndex root_index = tree.arena.alloc();
+        Node* root = &tree.arena[root_index];
         root->state = board;
-        root->pid = this->side;
+        root->pid = pid;
+        root->key = position_key(board, pid);
         root->untried_moves = root_moves;
-        shuffle(root->untried_moves.begin(), root->untried_moves.end(), gen);
-        
-        string winner = check_if_won(board, score_cols);
-        if (!winner.empty()) {
+        order_for_expansion(root->untried_moves, board, pid, score_cols, rng);
+        tree.node_table.emplace(root->key, root_index);
+
+        Player winner = check_if_won(board, score_cols);
+        if (winner != NO_PLAYER) {
             root->is_terminal = true;
             root->terminal_result = winner;
         }
-        
-        auto start_time = chrono::steady_clock::now();
-        while (chrono::duration<double>(chrono::steady_clock::now() - start_time).count() < time_limit) {
-            Node* leaf = mcts_select_init_node(root.get());
+        return root;
+    }
+
+    // called by the controlling thread between iterations. stops once no other
+    // root child can catch up with the most visited one before soft runs out,
+    // or once soft has passed and the most visited child has been the same for
+    // the last quarter of the soft budget. an unstable best move keeps the
+    // search going up to hard
+    bool should_stop(Node* root, SearchTree& tree, SearchClock& clock, double t) {
+        PackedMove best_move = NO_MOVE;
+        int best = 0, second = 0, last_visits = 0;
+        {
+            lock_guard<mutex> lock(root->mtx);
+            for (const auto& edge : root->children) {
+                int visits = tree.arena[edge.child].playouts;
+                if (edge.move == clock.last_best) last_visits = visits;
+                if (visits > best) {
+                    second = best;
+                    best = visits;
+                    best_move = edge.move;
+                }
+                else if (visits > second) second = visits;
+            }
+        }
+        if (best_move != clock.last_best && best > last_visits + clock.slack) {
+            clock.last_best = best_move;
+            clock.last_change = t;
+        }
+        if (best_move == NO_MOVE) return false;
+
+        double rate = (root->playouts - clock.start_visits) / max(t, 1e-3);
+        if (t >= clock.soft * 0.2 && t < clock.soft && best - second > rate * (clock.soft - t)) return true;
+        return t >= clock.soft && t - clock.last_change >= clock.soft * 0.25;
+    }
+
+    // one thread's select / expand / playout / backprop loop
+    // plays out the queued leaves as one batch and backs up their results
+    void flush_playouts(SearchWorker& worker, const vector<int>& score_cols, int virtual_loss) {
+        int n = worker.queued;
+        if (n == 0) return;
+        worker.batch_nodes.resize(n);
+        worker.batch_results.resize(n);
+        for (int i = 0; i < n; ++i) worker.batch_nodes[i] = worker.pending[i].start;
+        auto mark = chrono::steady_clock::now();
+        simulate_playouts(worker, worker.batch_nodes.data(), n, score_cols, worker.batch_results.data());
+        worker.stats.playout_time += lap(mark);
+        for (int i = 0; i < n; ++i) {
+            backpropagate(worker.pending[i].path, worker.batch_results[i], virtual_loss);
+            worker.iterations++;
+        }
+        worker.stats.backprop_time += lap(mark);
+        worker.queued = 0;
+    }
+
+    // with playout_batch > 1 leaves are queued and played out in groups.
+    // queued paths keep their virtual loss until the batch is flushed, so
+    // the selections in between spread over different leaves
+    void run_search(SearchTree& tree, SearchWorker& worker, Node* root, const vector<int>& score_cols, SearchClock& clock, bool controller, int virtual_loss) {
+        vector<Node*>& path = worker.path;
+        int batch = max(1, playout_batch);
+        if (batch > 1 && !virtual_loss) virtual_loss = VIRTUAL_LOSS;
+        if ((int)worker.pending.size() < batch) worker.pending.resize(batch);
+        worker.queued = 0;
+        SearchStats& stats = worker.stats;
+        int root_start = root->playouts;
+        auto mark = chrono::steady_clock::now();
+        auto note_depth = [&]() {
+            int depth = (int)path.size() - 1;
+            stats.depth_sum += depth;
+            stats.max_depth = max(stats.max_depth, depth);
+        };
+        auto play_out = [&](Node* start) {
+            note_depth();
+            if (batch == 1) {
+                double result = simulate_playout(worker, start, score_cols);
+                stats.playout_time += lap(mark);
+                backpropagate(path, result, virtual_loss);
+                worker.iterations++;
+                stats.backprop_time += lap(mark);
+                return;
+            }
+            PendingPlayout& slot = worker.pending[worker.queued++];
+            slot.path = path;
+            slot.start = start;
+            if (worker.queued == batch) flush_playouts(worker, score_cols, virtual_loss);
+        };
+        for (long long k = 0; !clock.stop.load(memory_order_relaxed); ++k) {
+            double t = clock.elapsed();
+            if (t >= clock.hard || (clock.node_limit && tree.arena.size() >= clock.node_limit) ||
+                (controller && k % 32 == 31 && should_stop(root, tree, clock, t))) {
+                clock.stop = true;
+                break;
+            }
+            if (clock.playout_limit && root->playouts - root_start >= clock.playout_limit) break;
+            mark = chrono::steady_clock::now();
+            Node* leaf = mcts_select_init_node(tree, root, path, virtual_loss);
+            stats.select_time += lap(mark);
             
             if (leaf->is_terminal) {
+                note_depth();
                 double result;
                 if (leaf->terminal_result == this->side) {
                     result = 1.0;
                 }
                 else {
-                    if (leaf->terminal_result.empty()) {
+                    if (leaf->terminal_result == NO_PLAYER) {
                         result = 0.5; // drawing this stuff dude
                     }
                     else {
                         result = 0.0;
                     } 
                 }
-                backpropagate(leaf, result);
+                backpropagate(path, result, virtual_loss);
+                worker.iterations++;
+                stats.backprop_time += lap(mark);
             } 
             else {
-                Node* child = mcts_expand_node(leaf, score_cols);
+                Node* child = mcts_expand_node(tree, worker, leaf, score_cols);
+                stats.expand_time += lap(mark);
                 if (child && child != leaf) {
-                    double result = simulate_playout(child, score_cols);
-                    backpropagate(child, result);
+                    stats.expansions++;
+                    if (find(path.begin(), path.end(), child) == path.end()) enter_node(path, child, virtual_loss);
+                    play_out(child);
                 } 
                 else if (!leaf->is_fully_expanded) {
-                    double result = simulate_playout(leaf, score_cols);
-                    backpropagate(leaf, result);
+                    play_out(leaf);
+                }
+                else {
+                    revert_virtual_loss(path, virtual_loss);
                 }
             }
         }
+        flush_playouts(worker, score_cols, virtual_loss);
+    }
+
+    // move_start is when the move's clock started. soft_limit and hard_limit
+    // count from there, so the time spent before the search is part of them
+    PackedMove find_mcts_move(const BoardState& position, const vector<int>& score_cols, chrono::steady_clock::time_point move_start = chrono::steady_clock::now()) {
+        BoardState board = prepare_board(position, score_cols);
+        auto root_moves = get_all_moves(board, this->side, score_cols);
+        // cout << root_moves.size() << " possible moves" << endl;
+        if (root_moves.empty()) return NO_MOVE;
 
-        if (root->children.empty()) {
+        Node* root = reuse_root(board, this->side);
+        if (root) {
+            last_reused_playouts = root->playouts;
+            last_reused_nodes = tree.arena.size();
+        }
+        else {
+            last_reused_playouts = 0;
+            last_reused_nodes = 0;
+            root = make_root(tree, board, this->side, root_moves, score_cols, gen);
+        }
+
+        int threads = num_threads;
+        vector<SearchWorker> workers(threads);
+        for (auto& worker : workers) worker.rng.seed(gen());
+        SearchClock clock;
+        clock.start = move_start;
+        clock.soft = soft_limit;
+        clock.hard = hard_limit;
+        clock.start_visits = root->playouts;
+        clock.playout_limit = playout_limit;
+        if (threads > 1 && parallel_mode == PARALLEL_TREE) clock.slack = threads * VIRTUAL_LOSS;
+        if (playout_batch > 1) clock.slack = max(clock.slack, (parallel_mode == PARALLEL_TREE ? threads : 1) * playout_batch * VIRTUAL_LOSS);
+
+        vector<Node*> roots = {root};
+        if (threads == 1) {
+            run_search(tree, workers[0], root, score_cols, clock, true, 0);
+        }
+        else if (parallel_mode == PARALLEL_TREE) {
+            tree.arena.reserve(node_cap);
+            vector<thread> pool;
+            for (int t = 1; t < threads; ++t) {
+                pool.emplace_back([&, t] { run_search(tree, workers[t], root, score_cols, clock, false, VIRTUAL_LOSS); });
+            }
+            run_search(tree, workers[0], root, score_cols, clock, true, VIRTUAL_LOSS);
+            for (auto& th : pool) th.join();
+        }
+        else {
+            while ((int)helper_trees.size() < threads - 1) helper_trees.push_back(make_unique<SearchTree>());
+            vector<thread> pool;
+            for (int t = 1; t < threads; ++t) {
+                SearchTree& helper = *helper_trees[t - 1];
+                helper.clear();
+                roots.push_back(make_root(helper, board, this->side, root_moves, score_cols, workers[t].rng));
+                Node* helper_root = roots.back();
+                pool.emplace_back([&, t, helper_root] { run_search(*helper_trees[t - 1], workers[t], helper_root, score_cols, clock, false, 0); });
+            }
+            run_search(tree, workers[0], root, score_cols, clock, true, 0);
+            for (auto& th : pool) th.join();
+        }
+
+        last_time_used = clock.elapsed();
+        last_tt_lookups = 0;
+        last_tt_hits = 0;
+        last_playouts = 0;
+        last_stats = SearchStats();
+        for (const auto& worker : workers) {
+            last_tt_lookups += worker.tt_lookups;
+            last_tt_hits += worker.tt_hits;
+            last_playouts += worker.iterations;
+            last_stats.add(worker.stats);
+        }
+        last_tt_nodes = tree.arena.size();
+        for (size_t t = 1; t < roots.size(); ++t) last_tt_nodes += helper_trees[t - 1]->arena.size();
+        last_threads = threads;
+        last_memory_bytes = tree_memory(tree);
+        for (size_t t = 1; t < roots.size(); ++t) last_memory_bytes += tree_memory(*helper_trees[t - 1]);
+        if (search_log.is_open()) write_search_log();
+
+        // merge the root children of every tree by move
+        vector<RootStat> root_stats;
+        for (size_t t = 0; t < roots.size(); ++t) {
+            SearchTree& owner = (t == 0) ? tree : *helper_trees[t - 1];
+            for (const auto& edge : roots[t]->children) {
+                Node& child = owner.arena[edge.child];
+                auto it = find_if(root_stats.begin(), root_stats.end(), [&](const RootStat& r) { return r.move == edge.move; });
+                if (it == root_stats.end()) root_stats.push_back({edge.move, child.wins, child.playouts});
+                else {
+                    it->wins += child.wins;
+                    it->playouts += child.playouts;
+                }
+            }
+        }
+        return pick_root_move(root_stats, root_moves);
+    }
+
+    // bytes a search tree holds: the slabs of both node arenas, the move
+    // lists of the nodes in use and the position table. one pass over the
+    // nodes, cheaper than the copy reuse_root makes of them
+    size_t tree_memory(SearchTree& t) {
+        size_t bytes = (t.arena.blocks.size() + t.spare_arena.blocks.size()) * NodeArena::BLOCK_SIZE * sizeof(Node);
+        for (size_t i = 0; i < t.arena.size(); ++i) {
+            Node& node = t.arena[i];
+            bytes += node.children.capacity() * sizeof(Edge) + node.untried_moves.capacity() * sizeof(PackedMove);
+        }
+        bytes += t.node_table.bucket_count() * sizeof(void*);
+        bytes += t.node_table.size() * (sizeof(pair<const uint64_t, NodeIndex>) + 2 * sizeof(void*));
+        return bytes;
+    }
+
+    void write_search_log() {
+        search_log << "{\"turn\": " << turn_count << ", \"side\": \"" << player_name(side) << "\"";
+        for (const auto& [name, value] : last_search_stats()) search_log << ", \"" << name << "\": " << value;
+        search_log << "}" << endl;
+    }
+
+    // looks the new position up in the table left by the previous search.
+    // on a hit the nodes under it are copied breadth first, shallowest first
+    // and at most node_cap / 8 of them, to the front of the spare arena and
+    // the arenas swap, which drops everything else in one rewind. the tree is
+    // a dag, so without the bound the copy would reach almost the whole
+    // arena. an edge into a dropped node goes back to its parent's untried
+    // moves. on a miss the arena is rewound and the caller builds a fresh root
+    Node* reuse_root(const BoardState& board, Player pid) {
+        NodeArena& arena = tree.arena;
+        NodeArena& spare_arena = tree.spare_arena;
+        auto found = tree.node_table.find(position_key(board, pid));
+        if (found == tree.node_table.end()) {
+            tree.clear();
+            return nullptr;
+        }
+
+        const NodeIndex dropped = numeric_limits<NodeIndex>::max();
+        size_t budget = max<size_t>(1, node_cap / 8);
+        vector<NodeIndex> remap(arena.size(), dropped);
+        vector<NodeIndex> order = {found->second};
+        spare_arena.reset();
+        remap[found->second] = spare_arena.alloc();
+        for (size_t k = 0; k < order.size() && order.size() < budget; ++k) {
+            for (const auto& edge : arena[order[k]].children) {
+                if (order.size() >= budget) break;
+                if (remap[edge.child] == dropped) {
+                    remap[edge.child] = spare_arena.alloc();
+                    order.push_back(edge.child);
+                }
+            }
+        }
+
+        tree.node_table.clear();
+        for (NodeIndex old_index : order) {
+            Node& node = spare_arena[remap[old_index]];
+            node.take(arena[old_index]);
+            size_t kept = 0;
+            for (size_t i = 0; i < node.children.size(); ++i) {
+                Edge edge = node.children[i];
+                if (remap[edge.child] == dropped) node.untried_moves.push_back(edge.move);
+                else node.children[kept++] = {edge.move, remap[edge.child]};
+            }
+            if (kept < node.children.size()) {
+                node.children.resize(kept);
+                node.is_fully_expanded = false;
+            }
+            tree.node_table.emplace(node.key, remap[old_index]);
+        }
+        arena.swap(spare_arena);
+        spare_arena.reset();
+        return &arena[0];
+    }
+
+    PackedMove pick_root_move(const vector<RootStat>& root_stats, const vector<PackedMove>& root_moves) {
+        if (root_stats.empty()) {
             // cout << "random move" << endl;
             return root_moves[0];
         }
 
 
-        Node* best_child = nullptr;
+        const RootStat* best_stat = nullptr;
         double best_win_rate = -1.0;
 
-        for (const auto& child : root->children) {
-            if (child->playouts > 0) {
-                double win_rate = (double)child->wins / (double)child->playouts;
+        for (const auto& stat : root_stats) {
+            if (stat.playouts > 0) {
+                double win_rate = (double)stat.wins / (double)stat.playouts;
                 if (win_rate > best_win_rate) {
                     best_win_rate = win_rate;
-                    best_child = child.get();
+                    best_stat = &stat;
                 }
             }
         }
         
-        if (best_child == nullptr) {
+        if (best_stat == nullptr) {
             int max_playouts = -1;
-            for (const auto& child : root->children) {
-                if (child->playouts > max_playouts) {
-                    max_playouts = child->playouts;
-                    best_child = child.get();
+            for (const auto& stat : root_stats) {
+                if (stat.playouts > max_playouts) {
+                    max_playouts = stat.playouts;
+                    best_stat = &stat;
                 }
             }
         }
@@ -944,30 +2315,30 @@ public:
         else {
             bool is_legal_move = false;
             for (const auto &rm : root_moves) {
-                if (is_equal_move(best_child->move, rm)) {
+                if (is_equal_move(best_stat->move, rm)) {
                     is_legal_move = true;
                     break;
                 }
             }
             if (is_legal_move) {
-                return best_child->move;
+                return best_stat->move;
             } 
             else {
 
-                Node* other_child = nullptr;
+                const RootStat* other_stat = nullptr;
                 int other_pl = -1;
-                for (const auto& child : root->children) {
+                for (const auto& stat : root_stats) {
                     for (const auto &rm : root_moves) {
-                        if (is_equal_move(child->move, rm)) {
-                            if (child->playouts > other_pl) {
-                                other_pl = child->playouts;
-                                other_child = child.get();
+                        if (is_equal_move(stat.move, rm)) {
+                            if (stat.playouts > other_pl) {
+                                other_pl = stat.playouts;
+                                other_stat = &stat;
                             }
                             break;
                         }
                     }
                 }
-                if (other_child != nullptr) return other_child->move;
+                if (other_stat != nullptr) return other_stat->move;
             }
         }
 
@@ -975,11 +2346,291 @@ public:
     }
 
 
-    Move choose(const BoardState& board, int, int, const vector<int>& score_cols, float, float) {
+    // scoring entries: a step or push landing in pid's scoring area, or a push
+    // that shoves one of pid's own pieces into it
+    bool is_scoring_move(PackedMove move, const BoardState& board, Player pid, const vector<int>& score_cols) {
+        uint32_t kind = move_kind(move);
+        if (kind != MOVE_STEP && kind != MOVE_PUSH) return false;
+        int p = pid;
+        int to = move_to(move);
+        if (in_scoring_area(to, p, score_cols)) return true;
+        if (kind == MOVE_PUSH && board.owner_at(to) == p) return in_scoring_area(move_pushed_to(move), p, score_cols);
+        return false;
+    }
+
+    int& history_score(Player pid, PackedMove move) {
+        return history[(pid * MAX_CELLS + move_from(move)) * MAX_CELLS + move_to(move)];
+    }
+
+    // sorts moves best first: hash move, scoring entries, killers for this
+    // ply, then the rest by history score
+    void order_moves(vector<PackedMove>& moves, const BoardState& board, Player pid, const vector<int>& score_cols, PackedMove hash_move, int ply) {
+        vector<pair<int, PackedMove>> scored;
+        scored.reserve(moves.size());
+        for (PackedMove move : moves) {
+            int score;
+            if (move == hash_move) score = 1 << 30;
+            else if (is_scoring_move(move, board, pid, score_cols)) score = 1 << 29;
+            else if (move == killers[ply][0]) score = (1 << 28) + 1;
+            else if (move == killers[ply][1]) score = 1 << 28;
+            else score = min(history_score(pid, move), (1 << 28) - 1);
+            scored.push_back({score, move});
+        }
+        stable_sort(scored.begin(), scored.end(), [](const pair<int, PackedMove>& a, const pair<int, PackedMove>& b) { return a.first > b.first; });
+        for (size_t i = 0; i < moves.size(); ++i) moves[i] = scored[i].second;
+    }
+
+    // mcts pops untried moves from the back, so the best come last. the
+    // shuffle keeps the order random among moves that score the same
+    void order_for_expansion(vector<PackedMove>& moves, const BoardState& board, Player pid, const vector<int>& score_cols, mt19937& rng) {
+        shuffle(moves.begin(), moves.end(), rng);
+        order_moves(moves, board, pid, score_cols, NO_MOVE, 0);
+        reverse(moves.begin(), moves.end());
+    }
+
+    PackedMove probe_hash_move(uint64_t key) {
+        const HashMove& entry = hash_moves[key & ((1 << HASH_MOVE_BITS) - 1)];
+        return (entry.key == key) ? entry.move : NO_MOVE;
+    }
+
+    void store_hash_move(uint64_t key, PackedMove move) {
+        HashMove& entry = hash_moves[key & ((1 << HASH_MOVE_BITS) - 1)];
+        entry.key = key;
+        entry.move = move;
+    }
+
+    // a quiet move that cut off becomes a killer for its ply and gains history
+    void note_cutoff(PackedMove move, const BoardState& board, Player pid, const vector<int>& score_cols, int depth, int ply) {
+        if (is_scoring_move(move, board, pid, score_cols)) return;
+        if (killers[ply][0] != move) {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = move;
+        }
+        history_score(pid, move) += depth * depth;
+    }
+
+    // static evaluation for alpha-beta from pid's side: pieces in and next to
+    // the scoring area as in evaluate_position, plus how far the remaining
+    // pieces still have to go
+    int ab_evaluate(const BoardState& board, Player pid, const vector<int>& score_cols) {
+        Player opp = opponent_of(pid);
+        int me = pid;
+        int score = 100 * (count_pieces_in_score_area(board, pid, score_cols) - count_pieces_in_score_area(board, opp, score_cols));
+        score += 20 * (count_pieces_near_score_area(board, pid, score_cols) - count_pieces_near_score_area(board, opp, score_cols));
+        for (int y = 0; y < board_rows; ++y) {
+            for (int x = 0; x < board_cols; ++x) {
+                int owner = board.owner(x, y);
+                if (owner < 0) continue;
+                int dist = closest_score_dist_at(board.index(x, y), owner, score_cols);
+                score += (owner == me) ? -dist : dist;
+            }
+        }
+        return score;
+    }
+
+    // negamax with principal variation search: the first move gets the full
+    // window, the rest a null window and a re-search if they beat alpha
+    int alphabeta(BoardState& board, Player pid, int depth, int alpha, int beta, int ply, const vector<int>& score_cols, SearchClock& clock) {
+        if ((++ab_nodes & 1023) == 0 && clock.elapsed() >= clock.hard) ab_abort = true;
+        if (ab_abort) return 0;
+
+        Player winner = check_if_won(board, score_cols);
+        if (winner != NO_PLAYER) return (winner == pid) ? AB_WIN - ply : -(AB_WIN - ply);
+        if (depth == 0) return ab_evaluate(board, pid, score_cols);
+
+        auto moves = get_all_moves(board, pid, score_cols);
+        if (moves.empty()) return 0;
+        uint64_t key = position_key(board, pid);
+        order_moves(moves, board, pid, score_cols, probe_hash_move(key), ply);
+
+        Player opp = opponent_of(pid);
+        UndoRecord undo;
+        int best = -AB_INF;
+        PackedMove best_move = moves[0];
+        for (size_t i = 0; i < moves.size(); ++i) {
+            make_move(board, moves[i], score_cols, undo);
+            int score;
+            if (i == 0) {
+                score = -alphabeta(board, opp, depth - 1, -beta, -alpha, ply + 1, score_cols, clock);
+            }
+            else {
+                score = -alphabeta(board, opp, depth - 1, -alpha - 1, -alpha, ply + 1, score_cols, clock);
+                if (score > alpha && score < beta) {
+                    score = -alphabeta(board, opp, depth - 1, -beta, -alpha, ply + 1, score_cols, clock);
+                }
+            }
+            unmake_move(board, undo);
+            if (ab_abort) return 0;
+
+            if (score > best) {
+                best = score;
+                best_move = moves[i];
+            }
+            if (score > alpha) alpha = score;
+            if (alpha >= beta) {
+                note_cutoff(moves[i], board, pid, score_cols, depth, ply);
+                break;
+            }
+        }
+        store_hash_move(key, best_move);
+        return best;
+    }
+
+    // one root iteration; moves[0] is searched first with the full window.
+    // returns the best score and sets best_move
+    int alphabeta_root(BoardState& board, const vector<PackedMove>& moves, int depth, int alpha, int beta, const vector<int>& score_cols, SearchClock& clock, PackedMove& best_move) {
+        UndoRecord undo;
+        int best = -AB_INF;
+        best_move = moves[0];
+        for (size_t i = 0; i < moves.size(); ++i) {
+            make_move(board, moves[i], score_cols, undo);
+            int score;
+            if (i == 0) {
+                score = -alphabeta(board, opponent_side, depth - 1, -beta, -alpha, 1, score_cols, clock);
+            }
+            else {
+                score = -alphabeta(board, opponent_side, depth - 1, -alpha - 1, -alpha, 1, score_cols, clock);
+                if (score > alpha && score < beta) {
+                    score = -alphabeta(board, opponent_side, depth - 1, -beta, -alpha, 1, score_cols, clock);
+                }
+            }
+            unmake_move(board, undo);
+            if (ab_abort) break;
+
+            if (score > best) {
+                best = score;
+                best_move = moves[i];
+            }
+            if (score > alpha) alpha = score;
+            if (alpha >= beta) {
+                note_cutoff(moves[i], board, this->side, score_cols, depth, 0);
+                break;
+            }
+        }
+        return best;
+    }
+
+    // iterative deepening inside the same soft_limit / hard_limit budget as
+    // mcts. each depth starts from an aspiration window around the previous
+    // score and falls back to a full window when the score lands outside it.
+    // an iteration cut off by the hard limit is thrown away
+    // move_start as for find_mcts_move
+    PackedMove find_alphabeta_move(const BoardState& position, const vector<int>& score_cols, chrono::steady_clock::time_point move_start = chrono::steady_clock::now()) {
+        BoardState start = prepare_board(position, score_cols);
+        auto moves = get_all_moves(start, this->side, score_cols);
+        if (moves.empty()) return NO_MOVE;
+
+        SearchClock clock;
+        clock.start = move_start;
+        clock.soft = soft_limit;
+        clock.hard = hard_limit;
+        ab_nodes = 0;
+        ab_abort = false;
+        last_ab_depth = 0;
+        last_ab_score = 0;
+        for (auto& ply_killers : killers) ply_killers[0] = ply_killers[1] = NO_MOVE;
+        // old history still helps, but should not outweigh this search
+        for (int& h : history) h /= 2;
+        order_moves(moves, start, this->side, score_cols, probe_hash_move(position_key(start, this->side)), 0);
+
+        BoardState board = start;
+        PackedMove best_move = moves[0];
+        int prev_score = 0;
+        for (int depth = 1; depth <= AB_MAX_DEPTH; ++depth) {
+            // the next depth costs more than everything so far, do not start it late
+            if (depth > 1 && clock.elapsed() >= clock.soft * 0.5) break;
+
+            int alpha = (depth > 1) ? prev_score - AB_ASPIRATION : -AB_INF;
+            int beta = (depth > 1) ? prev_score + AB_ASPIRATION : AB_INF;
+            PackedMove iteration_move;
+            int score;
+            while (true) {
+                score = alphabeta_root(board, moves, depth, alpha, beta, score_cols, clock, iteration_move);
+                if (ab_abort) break;
+                if (score <= alpha) alpha = -AB_INF;
+                else if (score >= beta) beta = AB_INF;
+                else break;
+            }
+            if (ab_abort) break;
+
+            best_move = iteration_move;
+            prev_score = score;
+            last_ab_depth = depth;
+            last_ab_score = score;
+            // search the previous best first at the next depth
+            auto best_it = find(moves.begin(), moves.end(), best_move);
+            rotate(moves.begin(), best_it, best_it + 1);
+            if (abs(score) >= AB_WIN - AB_MAX_DEPTH) break;
+        }
+        last_ab_nodes = ab_nodes;
+        last_time_used = clock.elapsed();
+        return best_move;
+    }
+
+    Move choose(const MapBoard& map_board, int rows, int cols, const vector<int>& score_cols, float current_player_time, float opponent_time) {
+        auto move_start = chrono::steady_clock::now();
+        if (pending.valid()) throw runtime_error("choose called while a choose_async search is pending");
+        return choose_move(map_board, rows, cols, score_cols, current_player_time, opponent_time, move_start);
+    }
+
+    // starts choose on a background thread and returns at once. the board is
+    // copied, so the caller may reuse it. poll() tells whether the move is
+    // ready and result() waits for it. until result() returns, poll and
+    // result are the only calls allowed; the others throw (see require_idle)
+    void choose_async(MapBoard map_board, int rows, int cols, vector<int> score_cols, float current_player_time, float opponent_time) {
+        if (pending.valid()) throw runtime_error("choose_async called before the previous result was collected");
+        auto move_start = chrono::steady_clock::now();
+        pending = async(launch::async, [this, map_board = std::move(map_board), rows, cols, score_cols = std::move(score_cols), current_player_time, opponent_time, move_start] {
+            return choose_move(map_board, rows, cols, score_cols, current_player_time, opponent_time, move_start);
+        });
+    }
+
+    bool poll() const {
+        return pending.valid() && pending.wait_for(chrono::seconds(0)) == future_status::ready;
+    }
+
+    Move result() {
+        if (!pending.valid()) throw runtime_error("result called without a pending choose_async search");
+        return pending.get();
+    }
+
+    // the setters and stats getters touch state a choose_async search reads
+    // and writes, so they refuse to run while one is pending
+    void require_idle(const char* call) const {
+        if (pending.valid()) throw runtime_error(string(call) + " called while a choose_async search is pending");
+    }
+
+    // choose for a board already in the one-byte-per-cell layout of pack_cells.
+    // the cells are read in place, without building the map board
+    Move choose_cells(const uint8_t* cells, int rows, int cols, const vector<int>& score_cols, float current_player_time, float opponent_time) {
+        auto move_start = chrono::steady_clock::now();
+        if (pending.valid()) throw runtime_error("choose called while a choose_async search is pending");
+        return choose_board(pack_cells(cells, rows, cols), score_cols, current_player_time, opponent_time, move_start);
+    }
+
+    Move choose_move(const MapBoard& map_board, int, int, const vector<int>& score_cols, float current_player_time, float opponent_time, chrono::steady_clock::time_point move_start) {
+        return choose_board(pack_board(map_board), score_cols, current_player_time, opponent_time, move_start);
+    }
+
+    // sets soft_limit / hard_limit for the next search. a position where
+    // either side already has pieces in its scoring area gets more time
+    void plan_search_time(const BoardState& board, const vector<int>& score_cols, float current_player_time, float opponent_time) {
+        if (fixed_move_time || current_player_time <= 0) {
+            soft_limit = hard_limit = time_limit;
+            return;
+        }
+        int scored = max(count_pieces_in_score_area(board, side, score_cols), count_pieces_in_score_area(board, opponent_side, score_cols));
+        double criticality = 1.0 + 0.25 * scored;
+        time_manager.plan(current_player_time, opponent_time, turn_count, criticality, soft_limit, hard_limit);
+    }
+
+    // move_start is when the choose call came in; converting the board, stopping
+    // the ponder thread and reusing the tree all count against the move's time
+    Move choose_board(const BoardState& position, const vector<int>& score_cols, float current_player_time, float opponent_time, chrono::steady_clock::time_point move_start = chrono::steady_clock::now()) {
+        stop_pondering();
         turn_count++;
-        board_rows = board.size();
-        if (board.empty()) return {};
-        board_cols = board[0].size();
+        if (position.rows == 0) return {};
+        BoardState board = prepare_board(position, score_cols);
 
         if (turn_count <= 12) {
             // cout<<"opening"<<endl;
@@ -988,42 +2639,208 @@ public:
         if (auto flip_move = find_immediate_flip_in_scoring_area(board, score_cols)) {
             // cout<<"flip"<<endl;
 
-            return *flip_move;
+            return unpack_move(*flip_move, board_cols);
         }
-        if (optional<Move> enter_move = find_direct_entry_path(board, score_cols)) {
-            // cout << "from " << (*enter_move).from[0] << "," << (*enter_move).from[1] << endl;
-            // cout << "to " << (*enter_move).to[0] << "," << (*enter_move).to[1] << endl;
-            // cout << "pushed to " << (*enter_move).pushed_to[0] << "," << (*enter_move).pushed_to[1] << endl;
-            // cout << "ori " << (*enter_move).orientation << endl;
+        if (optional<PackedMove> enter_move = find_direct_entry_path(board, score_cols)) {
+            // cout << "from " << move_from(*enter_move) % board_cols << "," << move_from(*enter_move) / board_cols << endl;
+            // cout << "to " << move_to(*enter_move) % board_cols << "," << move_to(*enter_move) / board_cols << endl;
             // cout<<"enter_move"<<endl;
 
-            return *enter_move;
+            return unpack_move(*enter_move, board_cols);
         }
         if (auto win_move = find_immediate_win(board, score_cols)) {
                     // cout<<"win_move"<<endl;
 
-            return *win_move;
+            return unpack_move(*win_move, board_cols);
         }
         if (auto block_move = block_opponent_win(board, score_cols)) {
                     // cout<<"block_opp"<<endl;
 
-            return *block_move;
+            return unpack_move(*block_move, board_cols);
         }
 
         // cout<<"mcts"<<endl;
         // print_board(board);
-        Move m_Ret = find_mcts_move(board, score_cols);
+        plan_search_time(board, score_cols, current_player_time, opponent_time);
+        if (engine == ENGINE_ALPHABETA) return unpack_move(find_alphabeta_move(board, score_cols, move_start), board_cols);
+        PackedMove best = find_mcts_move(board, score_cols, move_start);
+        if (pondering && best != NO_MOVE) start_pondering(try_move(board, best, score_cols), score_cols);
+        Move m_Ret = unpack_move(best, board_cols);
         // cout << "MCTS chose: " << m_Ret.action << " from (" << m_Ret.from[1] << "," << m_Ret.from[0] << ") to (" << m_Ret.to[1] << "," << m_Ret.to[0] << ") pushed_to (" << (m_Ret.pushed_to.empty() ? -1 : m_Ret.pushed_to[1]) << "," << (m_Ret.pushed_to.empty() ? -1 : m_Ret.pushed_to[0]) << ") orientation " << m_Ret.orientation << endl;
         return m_Ret;
     }
 
+    // searches the position after our move until stop_pondering or until the
+    // tree reaches node_cap. only called after an mcts move, when the tree
+    // already holds the subtree under that position
+    void start_pondering(const BoardState& board, const vector<int>& score_cols) {
+        ponder_clock.start = chrono::steady_clock::now();
+        ponder_clock.soft = ponder_clock.hard = numeric_limits<double>::infinity();
+        ponder_clock.node_limit = node_cap;
+        ponder_clock.stop = false;
+        uint32_t seed = gen();
+        ponder_thread = thread([this, board, score_cols, seed] {
+            SearchWorker worker;
+            worker.rng.seed(seed);
+            Node* root = reuse_root(board, opponent_side);
+            if (!root) {
+                auto moves = get_all_moves(board, opponent_side, score_cols, worker.move_gen_rivers);
+                if (moves.empty() || check_if_won(board, score_cols) != NO_PLAYER) return;
+                root = make_root(tree, board, opponent_side, moves, score_cols, worker.rng);
+            }
+            run_search(tree, worker, root, score_cols, ponder_clock, false, 0);
+            last_ponder_playouts = worker.iterations;
+        });
+    }
+
+    void stop_pondering() {
+        if (!ponder_thread.joinable()) return;
+        ponder_clock.stop = true;
+        ponder_thread.join();
+    }
+
+    // off by default. while on, the agent keeps one core busy between moves
+    void set_pondering(bool on) {
+        require_idle("set_pondering");
+        stop_pondering();
+        pondering = on;
+    }
+
+    // threads == 0 uses every hardware thread. mode is "root" for independent
+    // trees merged at the end or "tree" for one shared tree with virtual loss
+    void set_parallel(int threads, const string& mode) {
+        require_idle("set_parallel");
+        if (mode == "root") parallel_mode = PARALLEL_ROOT;
+        else if (mode == "tree") parallel_mode = PARALLEL_TREE;
+        else throw invalid_argument("parallel mode must be \"root\" or \"tree\"");
+        if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+        stop_pondering();
+        num_threads = threads;
+    }
+
+    // number of leaves a search thread collects before playing them out in
+    // lock-step; 1 plays every leaf out as soon as it is found
+    void set_playout_batch(int batch) {
+        require_idle("set_playout_batch");
+        stop_pondering();
+        playout_batch = max(1, batch);
+    }
+
+    // upper bound on tree size; once reached the search keeps running playouts
+    // from the existing leaves without growing the tree
+    void set_node_cap(size_t cap) {
+        require_idle("set_node_cap");
+        stop_pondering();
+        node_cap = max<size_t>(1, cap);
+    }
+
+    // exploration constant of the uct formula
+    void set_uct_c(double c) {
+        require_idle("set_uct_c");
+        stop_pondering();
+        uct_c = c;
+    }
+
+    // seconds > 0 searches every move for that long and ignores the clocks
+    // passed to choose; 0 goes back to planning from the clocks
+    void set_move_time(double seconds) {
+        require_idle("set_move_time");
+        stop_pondering();
+        fixed_move_time = seconds > 0;
+        if (fixed_move_time) time_limit = seconds;
+    }
+
+    // ends an mcts search after this many playouts, or at its time limit if
+    // that comes first. counted per tree, so root-parallel threads each play
+    // this many. 0: no limit
+    void set_playout_limit(int playouts) {
+        require_idle("set_playout_limit");
+        stop_pondering();
+        playout_limit = max(0, playouts);
+    }
+
+    // transposition stats of the last mcts search
+    map<string, double> get_tt_stats() const {
+        require_idle("get_tt_stats");
+        map<string, double> stats;
+        stats["lookups"] = (double)last_tt_lookups;
+        stats["hits"] = (double)last_tt_hits;
+        stats["hit_rate"] = last_tt_lookups ? (double)last_tt_hits / (double)last_tt_lookups : 0.0;
+        stats["nodes"] = (double)last_tt_nodes;
+        stats["reused_playouts"] = (double)last_reused_playouts;
+        stats["reused_nodes"] = (double)last_reused_nodes;
+        stats["playouts"] = (double)last_playouts;
+        stats["time_soft"] = soft_limit;
+        stats["time_hard"] = hard_limit;
+        stats["time_used"] = last_time_used;
+        stats["ponder_playouts"] = (double)last_ponder_playouts;
+        stats["ab_depth"] = last_ab_depth;
+        stats["ab_score"] = last_ab_score;
+        stats["ab_nodes"] = (double)last_ab_nodes;
+        return stats;
+    }
+
+    // telemetry of the last mcts search. phase times are summed over the
+    // search threads, so with several threads they add up to more than
+    // time_used
+    map<string, double> get_last_search_stats() const {
+        require_idle("get_last_search_stats");
+        return last_search_stats();
+    }
+
+    // get_last_search_stats without the idle check, for the search log
+    // written from inside the search
+    map<string, double> last_search_stats() const {
+        const SearchStats& s = last_stats;
+        map<string, double> stats;
+        stats["threads"] = last_threads;
+        stats["time_used"] = last_time_used;
+        stats["iterations"] = (double)last_playouts;
+        stats["expansions"] = (double)s.expansions;
+        stats["playouts"] = (double)s.playouts;
+        stats["playouts_per_sec"] = last_time_used > 0 ? s.playouts / last_time_used : 0.0;
+        stats["avg_playout_length"] = s.playouts ? (double)s.playout_plies / s.playouts : 0.0;
+        stats["avg_depth"] = last_playouts ? (double)s.depth_sum / last_playouts : 0.0;
+        stats["max_depth"] = s.max_depth;
+        stats["tree_nodes"] = (double)last_tt_nodes;
+        stats["memory_bytes"] = (double)last_memory_bytes;
+        stats["time_select"] = s.select_time;
+        stats["time_expand"] = s.expand_time;
+        stats["time_playout"] = s.playout_time;
+        stats["time_backprop"] = s.backprop_time;
+        stats["time_move_gen"] = s.move_gen_time;
+        return stats;
+    }
+
+    // appends get_last_search_stats as one json line per mcts search, with
+    // the turn and side, to path. an empty path closes the log
+    void set_search_log(const string& path) {
+        require_idle("set_search_log");
+        if (search_log.is_open()) search_log.close();
+        if (path.empty()) return;
+        search_log.open(path, ios::app);
+        if (!search_log) throw runtime_error("cannot open search log " + path);
+        search_log.precision(10);
+    }
+
 };
 
-StudentAgent::StudentAgent(string s) : side(move(s)), gen(rd()) {
-    opponent_side = (side == "circle") ? "square" : "circle";
+StudentAgent::StudentAgent(Player s, const string& engine_name) : side(s), gen(rd()) {
+    if (side == NO_PLAYER) throw invalid_argument("side must be \"circle\" or \"square\"");
+    opponent_side = opponent_of(side);
+    for (auto& ply_killers : killers) ply_killers[0] = ply_killers[1] = NO_MOVE;
+    if (engine_name == "mcts") engine = ENGINE_MCTS;
+    else if (engine_name == "alphabeta") engine = ENGINE_ALPHABETA;
+    else throw invalid_argument("engine must be \"mcts\" or \"alphabeta\"");
 }
 
-void print_board(const BoardState& board) {
+StudentAgent::~StudentAgent() {
+    // a pending choose_async search may still start pondering when it ends
+    if (pending.valid()) pending.wait();
+    stop_pondering();
+}
+
+void print_board(const MapBoard& board) {
     for (int y = 0; y < board.size(); ++y) {
         for (int x = 0; x < board[0].size(); ++x) {
             if (board[y][x].empty()) {
@@ -1048,6 +2865,7 @@ string flip(string ori) {
     return (ori=="horizontal") ? "vertical" :  ori;
 }
 
+#ifndef STUDENT_AGENT_NO_PYBIND
 PYBIND11_MODULE(student_agent_module, m) {
     py::class_<Move>(m, "Move")
         .def_readonly("action", &Move::action)
@@ -1056,6 +2874,37 @@ PYBIND11_MODULE(student_agent_module, m) {
         .def_readonly("pushed_to", &Move::pushed_to)
         .def_readonly("orientation", &Move::orientation);
     py::class_<StudentAgent>(m, "StudentAgent")
-        .def(py::init<string>())
-        .def("choose", &StudentAgent::choose);
-}
\ No newline at end of file
+        .def(py::init<string, string>(), py::arg("side"), py::arg("engine") = "mcts")
+        // the search never touches python objects, so other python threads
+        // keep running while it thinks. a board pack_board rejects (too many
+        // cells, ragged rows, an unknown owner) raises ValueError
+        .def("choose", &StudentAgent::choose, py::call_guard<py::gil_scoped_release>())
+        .def("choose_async", &StudentAgent::choose_async)
+        .def("poll", &StudentAgent::poll)
+        .def("result", &StudentAgent::result, py::call_guard<py::gil_scoped_release>())
+        // cells: c-contiguous uint8 array of shape (rows, cols), see encode_board
+        // in student_agent.py. noconvert() makes any other array a TypeError
+        // instead of a silent copy, and a byte that is not a cell code a
+        // ValueError. the array is read in place with the GIL released, so it
+        // must not be written to until the call returns
+        .def("choose_array", [](StudentAgent& agent, py::array_t<uint8_t, py::array::c_style> cells, const vector<int>& score_cols, float current_player_time, float opponent_time) {
+            if (cells.ndim() != 2) throw py::value_error("choose_array expects a 2d board array");
+            int rows = cells.shape(0);
+            int cols = cells.shape(1);
+            if (rows * cols > MAX_CELLS) throw py::value_error("board too large");
+            const uint8_t* data = cells.data();
+            py::gil_scoped_release release;
+            return agent.choose_cells(data, rows, cols, score_cols, current_player_time, opponent_time);
+        }, py::arg("cells").noconvert(), py::arg("score_cols"), py::arg("current_player_time"), py::arg("opponent_time"))
+        .def("get_tt_stats", &StudentAgent::get_tt_stats)
+        .def("get_last_search_stats", &StudentAgent::get_last_search_stats)
+        .def("set_search_log", &StudentAgent::set_search_log)
+        .def("set_node_cap", &StudentAgent::set_node_cap)
+        .def("set_uct_c", &StudentAgent::set_uct_c)
+        .def("set_move_time", &StudentAgent::set_move_time)
+        .def("set_playout_limit", &StudentAgent::set_playout_limit)
+        .def("set_parallel", &StudentAgent::set_parallel)
+        .def("set_playout_batch", &StudentAgent::set_playout_batch)
+        .def("set_pondering", &StudentAgent::set_pondering);
+}
+#endif
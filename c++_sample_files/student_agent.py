@@ -1,7 +1,36 @@
 import build.student_agent_module as student_agent
+import numpy as np
 from abc import ABC, abstractmethod
 from typing import List, Dict, Any, Optional
 
+# one byte per cell for choose_array, matching the CELL_* codes in student_agent.cpp
+CELL_OWNER = {"circle": 1, "square": 2}
+CELL_RIVER = 4
+CELL_VERTICAL = 8
+
+
+def encode_board(board: List[List[Any]], rows: int, cols: int, out: Optional[np.ndarray] = None) -> np.ndarray:
+    """Encode the engine board as a (rows, cols) uint8 array for choose_array.
+
+    Bits 0-1 hold the owner (0 empty, 1 circle, 2 square), bit 2 is set for rivers
+    and bit 3 for vertical rivers. Pass the previous result as out to reuse it.
+    """
+    if out is None or out.shape != (rows, cols):
+        out = np.zeros((rows, cols), dtype=np.uint8)
+    else:
+        out.fill(0)
+    for y in range(rows):
+        for x in range(cols):
+            piece = board[y][x]
+            if piece is None:
+                continue
+            code = CELL_OWNER[piece.owner]
+            if piece.side == "river":
+                code |= CELL_RIVER
+                if piece.orientation == "vertical":
+                    code |= CELL_VERTICAL
+            out[y, x] = code
+    return out
 
 def get_opponent(player: str) -> str:
     return "square" if player == "circle" else "circle"
@@ -52,12 +81,37 @@ class BaseAgent(ABC):
         pass
 
 class StudentAgent(BaseAgent):
-    def __init__(self, player: str):
+    def __init__(self, player: str, engine: str = "mcts"):
+        """engine is "mcts" or "alphabeta"."""
         super().__init__(player)
 
-        self.agent = student_agent.StudentAgent(player)
+        self.agent = student_agent.StudentAgent(player, engine)
+        self.cells = None
 
     def choose(self, board: List[List[Any]],  rows: int, cols: int, score_cols: List[int], current_player_time: float, opponent_time: float) -> Optional[Dict[str, Any]]:
+        # Pass the encoded board to the C++ agent; the array is read in place
+        self.cells = encode_board(board, rows, cols, self.cells)
+        cpp_move = self.agent.choose_array(self.cells, score_cols, current_player_time, opponent_time)
+        return self._move_to_dict(cpp_move)
+
+    def choose_async(self, board: List[List[Any]],  rows: int, cols: int, score_cols: List[int], current_player_time: float, opponent_time: float) -> None:
+        """Start a search in the background; collect it with result().
+
+        Until result() returns, only poll() and result() may be called; the
+        setters and stats getters raise RuntimeError.
+        """
+        self.agent.choose_async(self._convert_board(board, rows, cols), rows, cols, score_cols, current_player_time, opponent_time)
+
+    def poll(self) -> bool:
+        """True once the search started by choose_async has a move ready."""
+        return self.agent.poll()
+
+    def result(self) -> Optional[Dict[str, Any]]:
+        """Wait for the search started by choose_async and return its move."""
+        return self._move_to_dict(self.agent.result())
+
+    @staticmethod
+    def _convert_board(board: List[List[Any]], rows: int, cols: int) -> List[List[Dict[str, str]]]:
         board_to_pass = []
         for y in range(rows):
             row = []
@@ -69,9 +123,10 @@ class StudentAgent(BaseAgent):
                     # The C++ code expects keys and values to be strings.
                     row.append({"owner": piece.owner, "side": piece.side, "orientation": str(piece.orientation)})
             board_to_pass.append(row)
-        
-        # Pass the converted board to the C++ agent
-        cpp_move = self.agent.choose(board_to_pass, rows, cols, score_cols, current_player_time, opponent_time)
+        return board_to_pass
+
+    @staticmethod
+    def _move_to_dict(cpp_move) -> Optional[Dict[str, Any]]:
         if cpp_move is None:
             # print("none")
             return None
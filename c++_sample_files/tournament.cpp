@@ -0,0 +1,135 @@
+// Self-play tournament between two agent setups, no Python in the loop.
+//
+//   ./tournament [options] [agent_a] [agent_b]
+//
+//   --games N        games to play (default 100), colours alternate
+//   --threads N      games played at once (default: hardware threads)
+//   --time S         seconds on each player's clock (default 60)
+//   --max-turns N    draw after this many turns (default 1000)
+//   --rows R --cols C  board size (default 13 x 12)
+//   --log FILE       one CSV line per game
+//
+// An agent is "mcts" or "alphabeta", optionally with settings, e.g.
+// "mcts,threads=2,mode=tree,batch=8" (see AgentConfig in selfplay.h). Both
+// default to "mcts". Moves are checked and applied by referee.h, the rules of
+// gameEngine.py; a move the referee refuses passes the turn and makes the
+// exit status non-zero. Every game runs on wall-clock time, so keep
+// threads x agent threads at or below the number of cores.
+#define STUDENT_AGENT_NO_PYBIND
+#include "student_agent.cpp"
+#include "referee.h"
+#include "selfplay.h"
+#include <cstdio>
+#include <cstring>
+
+struct SideTotals {
+    int results[3] = {0, 0, 0};  // wins, draws, losses
+    int moves = 0;
+    double think_time = 0.0;
+    int passes = 0;
+    int rejected = 0;
+};
+
+int main(int argc, char** argv) {
+    GameSettings settings;
+    int games = 100;
+    int threads = max(1u, thread::hardware_concurrency());
+    string log_path;
+    vector<string> specs;
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--games") && has_value) games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && has_value) threads = max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--time") && has_value) settings.time_per_player = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--max-turns") && has_value) settings.max_turns = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rows") && has_value) settings.rows = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cols") && has_value) settings.cols = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--log") && has_value) log_path = argv[++i];
+        else if (argv[i][0] != '-' && specs.size() < 2) specs.push_back(argv[i]);
+        else {
+            fprintf(stderr, "usage: %s [--games N] [--threads N] [--time S] [--max-turns N] [--rows R] [--cols C] [--log FILE] [agent_a] [agent_b]\n", argv[0]);
+            return 2;
+        }
+    }
+    while (specs.size() < 2) specs.push_back("mcts");
+    if (settings.rows * settings.cols > MAX_CELLS) {
+        fprintf(stderr, "board %dx%d is larger than %d cells\n", settings.rows, settings.cols, MAX_CELLS);
+        return 2;
+    }
+    AgentConfig configs[2];
+    try {
+        for (int a = 0; a < 2; ++a) configs[a] = AgentConfig::parse(specs[a]);
+    } catch (const exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    FILE* log = nullptr;
+    if (!log_path.empty()) {
+        log = fopen(log_path.c_str(), "w");
+        if (!log) {
+            fprintf(stderr, "cannot open %s\n", log_path.c_str());
+            return 2;
+        }
+        fprintf(log, "game,circle,square,winner,end,turns,circle_ms_per_move,square_ms_per_move,circle_rejected,square_rejected\n");
+    }
+
+    // totals[a] for agent a, by_colour[a][p] for agent a playing player p
+    SideTotals totals[2];
+    int by_colour[2][2][3] = {};
+    int ends[3] = {0, 0, 0};
+    long long turns = 0;
+    int played = 0;
+    static const char* end_names[3] = {"win", "timeout", "turn_limit"};
+    auto start = chrono::steady_clock::now();
+
+    // agent a plays circle in even games, so both get each colour equally
+    run_games(games, threads, [&](int game) {
+        return play_game(configs[game % 2], configs[1 - game % 2], settings);
+    }, [&](int game, const GameRecord& record) {
+        played++;
+        ends[record.end]++;
+        turns += record.turns;
+        for (int p = 0; p < 2; ++p) {
+            int a = (game % 2 == 0) ? p : 1 - p;
+            int result = (record.winner < 0) ? 1 : (record.winner == p ? 0 : 2);
+            totals[a].results[result]++;
+            by_colour[a][p][result]++;
+            totals[a].moves += record.moves[p];
+            totals[a].think_time += record.think_time[p];
+            totals[a].passes += record.passes[p];
+            totals[a].rejected += record.rejected[p];
+        }
+        if (log) {
+            fprintf(log, "%d,%s,%s,%s,%s,%d,%.1f,%.1f,%d,%d\n", game,
+                    configs[game % 2].spec.c_str(), configs[1 - game % 2].spec.c_str(),
+                    record.winner < 0 ? "draw" : player_name(Player(record.winner)),
+                    end_names[record.end], record.turns,
+                    1e3 * record.think_time[0] / max(1, record.moves[0]),
+                    1e3 * record.think_time[1] / max(1, record.moves[1]),
+                    record.rejected[0], record.rejected[1]);
+            fflush(log);
+        }
+        fprintf(stderr, "\rgame %d/%d", played, games);
+        return true;
+    });
+    fprintf(stderr, "\n");
+    if (log) fclose(log);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%d games, %d at a time, %.0f s per player, %.0f s total\n", played, threads, settings.time_per_player, seconds);
+    printf("    %-28s %5s %5s %6s %6s %8s %6s %8s\n", "agent", "wins", "draws", "losses", "score", "ms/move", "passes", "rejected");
+    for (int a = 0; a < 2; ++a) {
+        const SideTotals& t = totals[a];
+        double score = played ? (t.results[0] + 0.5 * t.results[1]) / played : 0.0;
+        printf("%c   %-28s %5d %5d %6d %5.1f%% %8.1f %6d %8d\n", 'A' + a, configs[a].spec.c_str(),
+               t.results[0], t.results[1], t.results[2], 100.0 * score, 1e3 * t.think_time / max(1, t.moves), t.passes, t.rejected);
+    }
+    for (int p = 0; p < 2; ++p) {
+        const int* r = by_colour[0][p];
+        printf("A as %s: %d-%d-%d\n", player_name(Player(p)), r[0], r[1], r[2]);
+    }
+    printf("ended by win %d, timeout %d, turn limit %d; %.1f turns per game\n",
+           ends[END_WIN], ends[END_TIMEOUT], ends[END_TURN_LIMIT], played ? (double)turns / played : 0.0);
+    return (totals[0].rejected || totals[1].rejected) ? 1 : 0;
+}